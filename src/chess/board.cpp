@@ -5,7 +5,6 @@
 #include "zobrist.hpp"
 
 #include <cstdlib>
-#include <sstream>
 
 [[nodiscard]] char get_piece_ch(const BoardState &state, Square sq) {
     if (!state.occupancy().is_set(sq))
@@ -13,80 +12,13 @@
     return state.get_piece_type(sq).to_char(state.get_piece_color(sq));
 }
 
-Board::Board(std::string_view fen) {
-    history_.reserve(2048);
-    history_.emplace_back();
-    std::istringstream stream((std::string(fen)));
-
-    std::string position;
-    stream >> position;
-
-    i32 square = Square::A8;
-    for (const char &ch : position) {
-        if (ch == '/') {
-            square = square - 16 + square % 8;
-            continue;
-        }
-
-        if (std::isdigit(ch)) {
-            square += ch - '0';
-            continue;
-        }
-
-        state().place_piece(PieceType::from_char(ch), square, std::islower(ch) ? Color::BLACK : Color::WHITE);
-        square++;
-    }
-
-    char side_to_move;
-    stream >> side_to_move;
-    state().side_to_move = side_to_move == 'w' ? Color::WHITE : Color::BLACK;
-    if (state().side_to_move == Color::BLACK) {
-        state().hash_key ^= zobrist::side_to_move;
-    }
-
-    std::string castle_data;
-    stream >> castle_data;
-
-    if (castle_data != "-") {
-        for (const char ch : castle_data) {
-            if (ch == 'K') {
-                state().castle_rights.set_kingside_rook_file(Color::WHITE, File::H);
-            } else if (ch == 'Q') {
-                state().castle_rights.set_queenside_rook_file(Color::WHITE, File::A);
-            } else if (ch == 'k') {
-                state().castle_rights.set_kingside_rook_file(Color::BLACK, File::H);
-            } else if (ch == 'q') {
-                state().castle_rights.set_queenside_rook_file(Color::BLACK, File::A);
-            } else {
-                const auto color = std::isupper(ch) ? Color::WHITE : Color::BLACK;
-                const auto rook_file = File::from_char(ch);
-                if (rook_file > state().king(color).lsb().file()) {
-                    state().castle_rights.set_kingside_rook_file(color, rook_file);
-                } else {
-                    state().castle_rights.set_queenside_rook_file(color, rook_file);
-                }
-            }
-        }
-    }
-    state().hash_key ^= zobrist::castle_rights[state().castle_rights.to_mask()];
-
-    std::string en_passant;
-    stream >> en_passant;
-
-    if (en_passant != "-") {
-        state().en_passant_sq = Square::from_string(en_passant);
-        state().hash_key ^= zobrist::en_passant[state().en_passant_sq.file()];
-    }
-
-    int hmc;
-    stream >> hmc;
-    state().fifty_moves_clock = static_cast<u8>(hmc);
-    state().compute_masks();
-}
+Board::Board(std::string_view fen) : Board(BoardState::from_fen(fen)) {}
 
 Board::Board(const BoardState &board_state) {
     history_.reserve(2048);
+    repetitions_.reserve(2048);
     history_.push_back(board_state);
+    push_repetition();
 }
 
 BoardState &Board::state() {
@@ -101,25 +33,38 @@ const BoardState &Board::prev_state() const {
     return history_.at(history_.size() - 2);
 }
 
-Board::History &Board::history() {
-    return history_;
-}
-
 const Board::History &Board::history() const {
     return history_;
 }
 
 bool Board::has_threefold_repetition() const {
-    const u16 maximum_distance = std::min<u32>(state().fifty_moves_clock, history_.size());
-
-    u16 times_seen = 1;
-    for (i32 i = 3; i <= maximum_distance; i += 2) {
-        if (state().hash_key == history_[history_.size() - i].hash_key && ++times_seen == 3) {
-            return true;
+    return repetitions_.back().times_seen >= 3;
+}
+
+void Board::push_repetition() {
+    const usize ply = history_.size() - 1;
+    const HashKey key = state().hash_key;
+    auto &last = last_in_bucket_[key % REPETITION_BUCKETS];
+
+    RepetitionEntry entry{.previous_in_bucket = last, .times_seen = 1};
+    // Only positions within reach of the fifty move clock can be repeated. The previous occurrence already counted
+    // those before it, since its clock reaches back just as far.
+    const usize oldest = ply + 1 - std::min<usize>(state().fifty_moves_clock, ply + 1);
+    for (u32 prev = last; prev > oldest; prev = repetitions_[prev - 1].previous_in_bucket) {
+        const usize prev_ply = prev - 1;
+        if (history_[prev_ply].hash_key == key && (ply - prev_ply) % 2 == 0) {
+            entry.times_seen = repetitions_[prev_ply].times_seen + 1;
+            break;
         }
     }
 
-    return false;
+    repetitions_.push_back(entry);
+    last = ply + 1;
+}
+
+void Board::pop_repetition() {
+    last_in_bucket_[state().hash_key % REPETITION_BUCKETS] = repetitions_.back().previous_in_bucket;
+    repetitions_.pop_back();
 }
 
 bool Board::is_fifty_move_draw() const {
@@ -150,12 +95,27 @@ bool Board::is_draw() const {
     return is_fifty_move_draw() || is_material_draw() || has_threefold_repetition();
 }
 
-Move Board::create_move(std::string_view uci_move) const {
+Move Board::create_move(std::string_view uci_move, bool chess960) const {
+    const auto is_square = [](std::string_view sq) {
+        return 'a' <= sq[0] && sq[0] <= 'h' && '1' <= sq[1] && sq[1] <= '8';
+    };
+    if ((uci_move.size() != 4 && uci_move.size() != 5) || !is_square(uci_move.substr(0, 2)) ||
+        !is_square(uci_move.substr(2, 2))) {
+        throw std::runtime_error("cannot parse move");
+    }
+
+    const auto from = Square::from_string(uci_move.substr(0, 2));
+    const auto to = Square::from_string(uci_move.substr(2, 2));
+    const auto promo_type = uci_move.size() == 5 ? PieceType::from_char(uci_move[4]) : PieceType::NONE;
+
     MoveList moves;
     generate_moves(state(), moves);
 
     for (const auto move : moves) {
-        if (move.to_string() == uci_move) {
+        // Outside of Chess960 castling is written as the king moving two squares rather than onto its rook
+        const auto move_to = move.is_castling() && !chess960 ? move.king_castling_to() : move.to();
+        const auto move_promo_type = move.is_promo() ? move.promo_type() : PieceType::NONE;
+        if (move.from() == from && move_to == to && move_promo_type == promo_type) {
             return move;
         }
     }
@@ -185,6 +145,7 @@ void Board::make_move(Move move) {
         state().hash_key ^= zobrist::castle_rights[old_castle_rights_mask ^ state().castle_rights.to_mask()];
         state().hash_key ^= zobrist::side_to_move;
         state().compute_masks();
+        push_repetition();
         return;
     }
 
@@ -238,15 +199,17 @@ void Board::make_move(Move move) {
     state().hash_key ^= zobrist::side_to_move;
     state().side_to_move = ~state().side_to_move;
     state().compute_masks();
+    push_repetition();
 }
 
 void Board::undo_move() {
+    pop_repetition();
     history_.pop_back();
 }
 
 void Board::undo_n_moves(usize n) {
     while (n--) {
-        history_.pop_back();
+        undo_move();
     }
 }
 
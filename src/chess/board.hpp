@@ -2,6 +2,7 @@
 
 #include "../util/static_vector.hpp"
 #include "board_state.hpp"
+#include <array>
 #include <string_view>
 
 constexpr std::string_view STARTPOS_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
@@ -23,7 +24,8 @@ class Board {
     [[nodiscard]] bool is_material_draw() const;
     [[nodiscard]] bool is_draw() const;
 
-    [[nodiscard]] Move create_move(std::string_view uci_move) const;
+    // Parses a move in uci notation, where castling is written as the king taking its rook in Chess960
+    [[nodiscard]] Move create_move(std::string_view uci_move, bool chess960) const;
 
     void make_move(Move move);
     void undo_move();
@@ -32,9 +34,28 @@ class Board {
 
     friend std::ostream &operator<<(std::ostream &os, const Board &board);
 
-    [[nodiscard]] History &history();
+    // Read only, since the repetition tracking has to see every change. Positions are only added and removed through
+    // make_move and undo_move.
     [[nodiscard]] const History &history() const;
 
   private:
+    // Keep repetitions_ in step with history_, called after pushing a position and before popping one
+    void push_repetition();
+    void pop_repetition();
+
+    struct RepetitionEntry {
+        // Index + 1 in history_ of the previous position in the same bucket, or 0 if there is none
+        u32 previous_in_bucket;
+        // Occurrences of this position within the reach of the fifty move clock, including this one
+        u8 times_seen;
+    };
+
+    // Positions are chained by the low bits of their key, so finding the previous occurrence of a position rarely
+    // takes more than one step and draw checks don't have to scan back through the history
+    static constexpr usize REPETITION_BUCKETS = 1024;
+
     History history_;
+    std::vector<RepetitionEntry> repetitions_;
+    // Index + 1 in history_ of the latest position in each bucket, or 0 if there is none
+    std::array<u32, REPETITION_BUCKETS> last_in_bucket_{};
 };
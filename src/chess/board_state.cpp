@@ -1,9 +1,12 @@
 #include "board_state.hpp"
-#include "../uci/uci.hpp"
+#include "../util/string.hpp"
 #include "magics.hpp"
 #include "move_gen.hpp"
 
 #include <cassert>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
 #include <string>
 
 void BoardState::place_piece(PieceType piece_type, Square sq, Color color) {
@@ -110,71 +113,151 @@ void BoardState::compute_masks() {
     checkers |= pawns(~side_to_move) & PAWN_ATTACKS[our_king][side_to_move];
 }
 
-Bitboard BoardState::threats_by(Color color) const {
-    Bitboard threats = KING_MOVES[king(color).lsb()];
+Threats BoardState::compute_threats() const {
+    Threats res;
+    const auto occ = occupancy();
+    for (const Color color : {Color::WHITE, Color::BLACK}) {
+        const auto our_king = king(color).lsb();
+        const auto their_king = king(~color);
+
+        // The pins of the side to move are already known from compute_masks
+        Bitboard pinned = ortho_pins | diag_pins;
+        if (color != side_to_move) {
+            const auto ortho = rooks(~color) | queens(~color);
+            const auto diag = bishops(~color) | queens(~color);
+            pinned = 0;
+            for (auto potential_pinner : (BISHOP_RAYS[our_king] & diag) | (ROOK_RAYS[our_king] & ortho)) {
+                const auto ray = RAY_BETWEEN[our_king][potential_pinner];
+                const auto blockers = occ & ray;
+                pinned |= blockers.pop_count() == 1 ? ray | potential_pinner.to_bb() : 0;
+            }
+        }
 
-    const Bitboard occ = occupancy() ^ king(~color);
-    for (const auto sq : pawns(color)) {
-        threats |= PAWN_ATTACKS[sq][color];
-    }
-    for (const auto sq : knights(color)) {
-        threats |= KNIGHT_MOVES[sq];
-    }
-    for (const auto sq : bishops(color) | queens(color)) {
-        threats |= get_bishop_attacks(sq, occ);
-    }
-    for (const auto sq : rooks(color) | queens(color)) {
-        threats |= get_rook_attacks(sq, occ);
-    }
+        Bitboard threats = KING_MOVES[our_king];
+        Bitboard pinned_threats = threats;
 
-    return threats;
-}
+        for (const auto sq : pawns(color)) {
+            const auto cur_threats = PAWN_ATTACKS[sq][color];
+            threats |= cur_threats;
+            pinned_threats |= pinned.is_set(sq) ? cur_threats & RAY_BETWEEN[our_king][sq] : cur_threats;
+        }
+        for (const auto sq : knights(color)) {
+            threats |= KNIGHT_MOVES[sq];
+            pinned_threats |= pinned.is_set(sq) ? Bitboard(0) : KNIGHT_MOVES[sq];
+        }
 
-Bitboard BoardState::pinned_threats_by(Color color) const {
-    const auto our_king = king(color).lsb();
-    const auto ortho = rooks(~color) | queens(~color);
-    const auto diag = bishops(~color) | queens(~color);
+        const auto diag = bishops(color) | queens(color);
+        const auto ortho = rooks(color) | queens(color);
+        if constexpr (VECTOR_SLIDER_ATTACKS) {
+            // Filling is cheap enough to do twice rather than looking up pinned sliders and checks one at a time
+            threats |= get_slider_attacks(diag, ortho, occ ^ their_king);
+            pinned_threats |= get_slider_attacks(diag & ~pinned, ortho & ~pinned, occ);
+            for (const auto sq : diag & pinned) {
+                pinned_threats |= get_bishop_attacks(sq, occ) & RAY_BETWEEN[our_king][sq];
+            }
+            for (const auto sq : ortho & pinned) {
+                pinned_threats |= get_rook_attacks(sq, occ) & RAY_BETWEEN[our_king][sq];
+            }
+        } else {
+            // Attacks only change when the opposing king is removed from the occupancy if they reach it, so sliders
+            // need a second lookup just for checks
+            const auto add_slider = [&](Square sq, Bitboard cur_threats, auto &&attacks) {
+                threats |= (cur_threats & their_king) != 0 ? attacks(sq, occ ^ their_king) : cur_threats;
+                pinned_threats |= pinned.is_set(sq) ? cur_threats & RAY_BETWEEN[our_king][sq] : cur_threats;
+            };
+            for (const auto sq : diag) {
+                add_slider(sq, get_bishop_attacks(sq, occ), get_bishop_attacks);
+            }
+            for (const auto sq : ortho) {
+                add_slider(sq, get_rook_attacks(sq, occ), get_rook_attacks);
+            }
+        }
 
-    Bitboard pinned = 0;
-    const auto occ = occupancy();
-    for (auto potential_pinner : (BISHOP_RAYS[our_king] & diag) | (ROOK_RAYS[our_king] & ortho)) {
-        const auto ray = RAY_BETWEEN[our_king][potential_pinner];
-        const auto blockers = occ & ray;
-        pinned |= blockers.pop_count() == 1 ? ray | potential_pinner.to_bb() : 0;
+        res.threats[color] = threats;
+        res.pinned_threats[color] = pinned_threats;
     }
+    return res;
+}
 
-    Bitboard threats = KING_MOVES[king(color).lsb()];
+BoardState BoardState::from_fen(std::string_view fen) {
+    BoardState state;
+
+    usize pos = 0;
+    const auto next_field = [&]() {
+        while (pos < fen.size() && fen[pos] == ' ') {
+            ++pos;
+        }
+        const auto start = pos;
+        while (pos < fen.size() && fen[pos] != ' ') {
+            ++pos;
+        }
+        return fen.substr(start, pos - start);
+    };
+
+    i32 square = Square::A8;
+    for (const char ch : next_field()) {
+        if (ch == '/') {
+            square = square - 16 + square % 8;
+            continue;
+        }
+
+        if (std::isdigit(ch)) {
+            square += ch - '0';
+            continue;
+        }
 
-    for (const auto sq : pawns(color)) {
-        auto cur_threats = PAWN_ATTACKS[sq][color];
-        if (pinned.is_set(sq)) {
-            cur_threats &= RAY_BETWEEN[our_king][sq];
+        const auto piece_type = PieceType::from_char(ch);
+        if (piece_type == PieceType::NONE || square < Square::A1 || square > Square::H8) {
+            throw std::runtime_error("invalid fen");
         }
-        threats |= cur_threats;
+        state.place_piece(piece_type, square, std::islower(ch) ? Color::BLACK : Color::WHITE);
+        square++;
     }
-    for (const auto sq : knights(color) & ~pinned) {
-        threats |= KNIGHT_MOVES[sq];
+
+    state.side_to_move = next_field() == "b" ? Color::BLACK : Color::WHITE;
+    if (state.side_to_move == Color::BLACK) {
+        state.hash_key ^= zobrist::side_to_move;
     }
-    for (const auto sq : bishops(color) | queens(color)) {
-        auto cur_threats = get_bishop_attacks(sq, occ);
-        if (pinned.is_set(sq)) {
-            cur_threats &= RAY_BETWEEN[our_king][sq];
+
+    for (const char ch : next_field()) {
+        if (ch == 'K') {
+            state.castle_rights.set_kingside_rook_file(Color::WHITE, File::H);
+        } else if (ch == 'Q') {
+            state.castle_rights.set_queenside_rook_file(Color::WHITE, File::A);
+        } else if (ch == 'k') {
+            state.castle_rights.set_kingside_rook_file(Color::BLACK, File::H);
+        } else if (ch == 'q') {
+            state.castle_rights.set_queenside_rook_file(Color::BLACK, File::A);
+        } else if ('a' <= std::tolower(ch) && std::tolower(ch) <= 'h') {
+            const auto color = std::isupper(ch) ? Color::WHITE : Color::BLACK;
+            const auto rook_file = File::from_char(ch);
+            if (rook_file > state.king(color).lsb().file()) {
+                state.castle_rights.set_kingside_rook_file(color, rook_file);
+            } else {
+                state.castle_rights.set_queenside_rook_file(color, rook_file);
+            }
         }
-        threats |= cur_threats;
     }
-    for (const auto sq : rooks(color) | queens(color)) {
-        auto cur_threats = get_rook_attacks(sq, occ);
-        if (pinned.is_set(sq)) {
-            cur_threats &= RAY_BETWEEN[our_king][sq];
-        }
-        threats |= cur_threats;
+    state.hash_key ^= zobrist::castle_rights[state.castle_rights.to_mask()];
+
+    const auto en_passant = next_field();
+    if (en_passant.size() == 2) {
+        state.en_passant_sq = Square::from_string(en_passant);
+        state.hash_key ^= zobrist::en_passant[state.en_passant_sq.file()];
+    }
+
+    // Epd has operations instead of clocks, in which case the clock is left at zero
+    if (const auto fifty_moves_clock = util::parse_number<u32>(next_field())) {
+        state.fifty_moves_clock = static_cast<u8>(*fifty_moves_clock);
     }
 
-    return threats;
+    state.compute_masks();
+    return state;
 }
 
-std::string BoardState::to_fen() const {
-    std::string res;
+usize BoardState::write_fen(std::span<char, MAX_FEN_LENGTH> out, bool chess960) const {
+    usize len = 0;
+    const auto put = [&](char ch) { out[len++] = ch; };
 
     for (i32 i = 8; i-- > 0;) {
         i32 empty = 0;
@@ -187,70 +270,73 @@ std::string BoardState::to_fen() const {
             }
 
             if (empty) {
-                res += '0' + empty;
+                put('0' + empty);
                 empty = 0;
             }
 
-            const auto col = get_piece_color(sq);
-            res += pt.to_char(col);
+            put(pt.to_char(get_piece_color(sq)));
         }
 
         if (empty) {
-            res += '0' + empty;
-            empty = 0;
+            put('0' + empty);
         }
 
-        if (i)
-            res += '/';
+        if (i) {
+            put('/');
+        }
     }
 
-    res += ' ';
-    res += side_to_move == Color::WHITE ? 'w' : 'b';
-    res += ' ';
+    put(' ');
+    put(side_to_move == Color::WHITE ? 'w' : 'b');
+    put(' ');
 
-    if (castle_rights.to_mask() != 0) {
-        if (std::get<bool>(uci::options.get("UCI_Chess960")->value_as_variant())) {
-            if (castle_rights.can_kingside_castle(Color::WHITE)) {
-                res += castle_rights.kingside_rook(Color::WHITE).file().to_char();
-            }
-            if (castle_rights.can_queenside_castle(Color::WHITE)) {
-                res += castle_rights.queenside_rook(Color::WHITE).file().to_char();
-            }
-            if (castle_rights.can_kingside_castle(Color::BLACK)) {
-                res += castle_rights.kingside_rook(Color::BLACK).file().to_char();
-            }
-            if (castle_rights.can_queenside_castle(Color::BLACK)) {
-                res += castle_rights.queenside_rook(Color::BLACK).file().to_char();
-            }
-        } else {
-            if (castle_rights.can_kingside_castle(Color::WHITE)) {
-                res += 'K';
-            }
-            if (castle_rights.can_queenside_castle(Color::WHITE)) {
-                res += 'Q';
-            }
-            if (castle_rights.can_kingside_castle(Color::BLACK)) {
-                res += 'k';
-            }
-            if (castle_rights.can_queenside_castle(Color::BLACK)) {
-                res += 'q';
-            }
+    if (castle_rights.to_mask() == 0) {
+        put('-');
+    } else if (chess960) {
+        if (castle_rights.can_kingside_castle(Color::WHITE)) {
+            put(std::toupper(castle_rights.kingside_rook(Color::WHITE).file().to_char()));
+        }
+        if (castle_rights.can_queenside_castle(Color::WHITE)) {
+            put(std::toupper(castle_rights.queenside_rook(Color::WHITE).file().to_char()));
+        }
+        if (castle_rights.can_kingside_castle(Color::BLACK)) {
+            put(castle_rights.kingside_rook(Color::BLACK).file().to_char());
+        }
+        if (castle_rights.can_queenside_castle(Color::BLACK)) {
+            put(castle_rights.queenside_rook(Color::BLACK).file().to_char());
         }
     } else {
-        res += '-';
+        if (castle_rights.can_kingside_castle(Color::WHITE)) {
+            put('K');
+        }
+        if (castle_rights.can_queenside_castle(Color::WHITE)) {
+            put('Q');
+        }
+        if (castle_rights.can_kingside_castle(Color::BLACK)) {
+            put('k');
+        }
+        if (castle_rights.can_queenside_castle(Color::BLACK)) {
+            put('q');
+        }
     }
 
-    res += ' ';
+    put(' ');
     if (en_passant_sq != Square::NO_SQUARE) {
-        res += en_passant_sq.file().to_char();
-        res += en_passant_sq.rank().to_char();
+        put(en_passant_sq.file().to_char());
+        put(en_passant_sq.rank().to_char());
     } else {
-        res += '-';
+        put('-');
     }
 
-    res += ' ';
-    res += std::to_string(fifty_moves_clock);
-    res += ' ';
-    res += '1';
-    return res;
+    put(' ');
+    const auto [end, ec] = std::to_chars(out.data() + len, out.data() + out.size(), static_cast<u32>(fifty_moves_clock));
+    len = end - out.data();
+    put(' ');
+    put('1');
+    return len;
+}
+
+std::string BoardState::to_fen(bool chess960) const {
+    std::array<char, MAX_FEN_LENGTH> buffer;
+    return std::string(buffer.data(), write_fen(buffer, chess960));
 }
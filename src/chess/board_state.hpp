@@ -8,6 +8,19 @@
 #include "move.hpp"
 #include "zobrist.hpp"
 #include <ostream>
+#include <span>
+#include <string_view>
+
+// Longest fen write_fen can produce: 71 characters of piece placement, then the side to move, four castling rights, an
+// en passant square, a three digit clock and the move number, with spaces in between
+constexpr usize MAX_FEN_LENGTH = 87;
+
+// Squares attacked by each side, either seeing through the opposing king or only counting attacks that pinned pieces
+// can make
+struct Threats {
+    std::array<Bitboard, 2> threats;
+    std::array<Bitboard, 2> pinned_threats;
+};
 
 struct BoardState {
     void place_piece(PieceType piece_type, Square sq, Color color);
@@ -31,8 +44,9 @@ struct BoardState {
     [[nodiscard]] PieceType get_piece_type(Square sq) const;
     [[nodiscard]] Color get_piece_color(Square sq) const;
 
-    [[nodiscard]] Bitboard threats_by(Color color) const;
-    [[nodiscard]] Bitboard pinned_threats_by(Color color) const;
+    // Computes all four threat maps in one pass. Nothing is cached, so that states stay cheap to copy into the
+    // history, and callers that need the maps more than once should hold on to the result.
+    [[nodiscard]] Threats compute_threats() const;
 
     std::array<Bitboard, 6> piece_bbs{};
     std::array<Bitboard, 2> side_bbs{};
@@ -47,7 +61,12 @@ struct BoardState {
     Bitboard checkers{};
 
     void compute_masks();
-    [[nodiscard]] std::string to_fen() const;
+
+    // Parses a fen, or an epd whose clocks are missing or replaced by operations, without allocating
+    [[nodiscard]] static BoardState from_fen(std::string_view fen);
+    // Writes the fen into out and returns its length. Castling rights are written as rook files for Chess960.
+    usize write_fen(std::span<char, MAX_FEN_LENGTH> out, bool chess960) const;
+    [[nodiscard]] std::string to_fen(bool chess960) const;
 };
 
 inline bool operator==(const BoardState &lhs, const BoardState &rhs) noexcept {
@@ -1,43 +1,19 @@
 #include "magics.hpp"
+#include "../third_party/incbin.h"
 #include "move_gen.hpp"
-#include <functional>
-#include <vector>
-
-std::vector<Bitboard> create_blockers(Bitboard moves) {
-    std::vector<u8> set_bits;
-    set_bits.reserve(moves.pop_count());
-
-    // store the indices (from the lsb) of each set bit in the moves bitboard
-    for (int square = 0; square < 64; square++) {
-        if (moves.is_set(square)) {
-            set_bits.push_back(square);
-        }
-    }
-
-    std::vector<Bitboard> blockers;
-    Bitboard subset = moves;
 
-    for (u64 i = 0; i <= 1ull << set_bits.size(); i++) {
-        Bitboard blocker;
-        for (const auto bit : set_bits) {
-            // check if the bit is set in subset, not in the index
-            if (subset.is_set(bit)) {
-                blocker.set(bit);
-            }
-        }
+#include <cstdlib>
+#include <iostream>
 
-        blockers.push_back(blocker);
-
-        // Carey-Ripley method to get next blocker subset
-        subset = (subset - 1) & moves;
-    }
-
-    return blockers;
-}
+#if defined(USE_PEXT) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
+// With pext the index is the masked occupancy compressed into its low bits, which is below 2^popcount(mask) and so fits
+// the same entries as the magic indices
 u32 get_bishop_attack_idx(Square sq, Bitboard occ) {
 #ifdef USE_PEXT
-    return _pext_u64(static_cast<u64>(occupied), BISHOP_MAGICS[square].mask);
+    return static_cast<u32>(_pext_u64(static_cast<u64>(occ), BISHOP_MAGICS[sq].mask));
 #else
     const auto &entry = BISHOP_MAGICS[sq];
     return (static_cast<u64>(occ & entry.mask) * entry.magic) >> entry.shift;
@@ -46,34 +22,13 @@ u32 get_bishop_attack_idx(Square sq, Bitboard occ) {
 
 u32 get_rook_attack_idx(Square sq, Bitboard occ) {
 #ifdef USE_PEXT
-    return _pext_u64(static_cast<u64>(occupied), ROOK_MAGICS[square].mask);
+    return static_cast<u32>(_pext_u64(static_cast<u64>(occ), ROOK_MAGICS[sq].mask));
 #else
     const auto &entry = ROOK_MAGICS[sq];
     return (static_cast<u64>(occ & entry.mask) * entry.magic) >> entry.shift;
 #endif
 }
 
-template <typename AttacksTable, typename MagicEntry, usize BLOCKER_COMBINATIONS>
-AttacksTable generate_attacks_table(const std::array<MagicEntry, 64> &magics,
-                                    const std::function<Bitboard(Square, Bitboard)> &generate_moves_fn,
-                                    const std::function<u64(Square, Bitboard)> &get_idx_fn) {
-    AttacksTable attacks{};
-
-    for (int square = 0; square < 64; square++) {
-        auto blockers = create_blockers(magics[square].mask);
-        std::array<Bitboard, BLOCKER_COMBINATIONS> square_attacks{};
-
-        for (const auto &occupied : blockers) {
-            const u64 index = get_idx_fn(Square(square), occupied);
-            square_attacks[index] = generate_moves_fn(Square(square), occupied);
-        }
-
-        attacks[square] = square_attacks;
-    }
-
-    return attacks;
-}
-
 Bitboard compute_bishop_attacks(Square sq, Bitboard occ) {
     const Bitboard s = sq.to_bb();
     const Bitboard diag = static_cast<u64>(BISHOP_RAYS[sq] & Bitboard::get_ray_precomputed<UP, LEFT>(sq) |
@@ -114,26 +69,70 @@ Bitboard compute_rook_attacks(Square sq, Bitboard occ) {
     return (attacks_rank & rank) | (attacks_file & file);
 }
 
-util::MultiArray<Bitboard, 64, 512> BISHOP_ATTACKS = []() {
-    return generate_attacks_table<decltype(BISHOP_ATTACKS), decltype(BISHOP_MAGICS)::value_type, 512>(
-        BISHOP_MAGICS, compute_bishop_attacks, get_bishop_attack_idx);
+// Rook and bishop attacks of every square and relevant occupancy in one dense table, indexed from ROOK_OFFSETS and
+// BISHOP_OFFSETS. The tables are generated from the magics by tools/generate_slider_attacks.py and embedded as they are,
+// so neither startup nor compiling this file pays for building them. The Makefile passes the one matching USE_PEXT.
+INCBIN(SLIDERATTACKS, SLIDERATTACKSFILE);
+
+// A table that doesn't fit the magics would be read out of bounds, so rather refuse to start
+[[maybe_unused]] const bool slider_attacks_checked = [] {
+    if (gSLIDERATTACKSSize != BISHOP_OFFSETS[64] * sizeof(u64)) {
+        std::cerr << "embedded slider attacks are " << gSLIDERATTACKSSize << " bytes, expected "
+                  << BISHOP_OFFSETS[64] * sizeof(u64) << ", rerun tools/generate_slider_attacks.py" << std::endl;
+        std::exit(1);
+    }
+    return true;
 }();
 
-util::MultiArray<Bitboard, 64, 4096> ROOK_ATTACKS = []() {
-    return generate_attacks_table<decltype(ROOK_ATTACKS), decltype(ROOK_MAGICS)::value_type, 4096>(
-        ROOK_MAGICS, compute_rook_attacks, get_rook_attack_idx);
-}();
+[[nodiscard]] const u64 *slider_attacks() {
+    return reinterpret_cast<const u64 *>(gSLIDERATTACKSData);
+}
 
 [[nodiscard]] Bitboard get_bishop_attacks(Square sq, Bitboard occ) {
 #ifdef USE_HYPERBOLA_QUINTESSENCE
     return compute_bishop_attacks(sq, occ);
 #endif
-    return BISHOP_ATTACKS[sq][get_bishop_attack_idx(sq, occ)];
+    return slider_attacks()[BISHOP_OFFSETS[sq] + get_bishop_attack_idx(sq, occ)];
 }
 
 [[nodiscard]] Bitboard get_rook_attacks(Square sq, Bitboard occ) {
 #ifdef USE_HYPERBOLA_QUINTESSENCE
     return compute_rook_attacks(sq, occ);
 #endif
-    return ROOK_ATTACKS[sq][get_rook_attack_idx(sq, occ)];
+    return slider_attacks()[ROOK_OFFSETS[sq] + get_rook_attack_idx(sq, occ)];
+}
+
+[[nodiscard]] Bitboard get_slider_attacks(Bitboard bishops, Bitboard rooks, Bitboard occ) {
+#ifdef __AVX512F__
+    // Kogge-Stone fills of all eight directions at once, one per lane: the rook directions north, east, south and west
+    // followed by the bishop directions. Rotating rather than shifting lets one instruction step every lane, and
+    // masking out the squares a step could wrap onto keeps the rays on the board.
+    const __m512i step = _mm512_setr_epi64(8, 1, 56, 63, 9, 57, 55, 7);
+    const __m512i on_board = _mm512_setr_epi64(0xffffffffffffff00, 0xfefefefefefefefe, 0x00ffffffffffffff,
+                                               0x7f7f7f7f7f7f7f7f, 0xfefefefefefefe00, 0x00fefefefefefefe,
+                                               0x007f7f7f7f7f7f7f, 0x7f7f7f7f7f7f7f00);
+
+    __m512i gen = _mm512_mask_blend_epi64(0xf0, _mm512_set1_epi64(static_cast<u64>(rooks)),
+                                          _mm512_set1_epi64(static_cast<u64>(bishops)));
+    __m512i pro = _mm512_andnot_si512(_mm512_set1_epi64(static_cast<u64>(occ)), on_board);
+
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_rolv_epi64(gen, step)));
+    pro = _mm512_and_si512(pro, _mm512_rolv_epi64(pro, step));
+    const __m512i step2 = _mm512_slli_epi64(step, 1);
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_rolv_epi64(gen, step2)));
+    pro = _mm512_and_si512(pro, _mm512_rolv_epi64(pro, step2));
+    const __m512i step4 = _mm512_slli_epi64(step, 2);
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_rolv_epi64(gen, step4)));
+
+    return _mm512_reduce_or_epi64(_mm512_and_si512(_mm512_rolv_epi64(gen, step), on_board));
+#else
+    Bitboard attacks = 0;
+    for (const auto sq : bishops) {
+        attacks |= get_bishop_attacks(sq, occ);
+    }
+    for (const auto sq : rooks) {
+        attacks |= get_rook_attacks(sq, occ);
+    }
+    return attacks;
+#endif
 }
@@ -5,12 +5,29 @@
 #include "../util/types.hpp"
 #include "bitboard.hpp"
 
+// Whether slider attacks are indexed with BMI2 pext rather than magic multiplication, see build=bmi2 in the Makefile
+#ifdef USE_PEXT
+constexpr bool PEXT_ATTACKS = true;
+#else
+constexpr bool PEXT_ATTACKS = false;
+#endif
+
+// Whether the combined attacks of all sliders of a side are computed at once with AVX-512 fills rather than looked up
+// square by square
+#ifdef __AVX512F__
+constexpr bool VECTOR_SLIDER_ATTACKS = true;
+#else
+constexpr bool VECTOR_SLIDER_ATTACKS = false;
+#endif
+
 struct MagicEntry {
     u64 mask;
     u64 magic;
     i32 shift;
 };
 
+// The embedded slider attack tables are generated from these by tools/generate_slider_attacks.py, which has to be rerun
+// whenever they change
 // clang-format off
 constexpr std::array<MagicEntry, 64> ROOK_MAGICS = {
     MagicEntry{0x000101010101017eull, 0x2480001240002088ull, 52},
@@ -147,13 +164,27 @@ constexpr std::array<MagicEntry, 64> BISHOP_MAGICS = {
 };
 // clang-format on
 
-extern util::MultiArray<Bitboard, 64, 512> BISHOP_ATTACKS;
-extern util::MultiArray<Bitboard, 64, 4096> ROOK_ATTACKS;
+// Start of each square's attacks in the slider attack table of about 840 KB, with the end of the last square at index
+// 64. Each square only gets the 2^(64 - shift) entries its magic can index, rather than padding every square to the
+// largest.
+[[nodiscard]] constexpr std::array<u32, 65> attack_offsets(const std::array<MagicEntry, 64> &magics, u32 start) {
+    std::array<u32, 65> offsets{};
+    offsets[0] = start;
+    for (usize sq = 0; sq < 64; ++sq) {
+        offsets[sq + 1] = offsets[sq] + (1u << (64 - magics[sq].shift));
+    }
+    return offsets;
+}
+
+constexpr auto ROOK_OFFSETS = attack_offsets(ROOK_MAGICS, 0);
+constexpr auto BISHOP_OFFSETS = attack_offsets(BISHOP_MAGICS, ROOK_OFFSETS[64]);
 
 [[nodiscard]] Bitboard compute_bishop_attacks(Square sq, Bitboard occ);
 [[nodiscard]] Bitboard compute_rook_attacks(Square sq, Bitboard occ);
 
 [[nodiscard]] Bitboard get_bishop_attacks(Square sq, Bitboard occ);
 [[nodiscard]] Bitboard get_rook_attacks(Square sq, Bitboard occ);
+// Union of the attacks of every bishop and every rook given, queens belong in both
+[[nodiscard]] Bitboard get_slider_attacks(Bitboard bishops, Bitboard rooks, Bitboard occ);
 
 #endif // PRECOMPUTED_HPP
@@ -0,0 +1,136 @@
+#ifndef ACCUMULATOR_CACHE_HPP
+#define ACCUMULATOR_CACHE_HPP
+
+#include "features.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace network {
+
+// A "Finny table" entry: an accumulator computed for one (perspective, king mirror) bucket together with the features
+// it was built from. Refreshing an entry only touches the rows of features that differ from the new position, which for
+// nearby positions in the tree is a handful of rows instead of every piece on the board.
+template <typename Accumulator>
+struct AccumulatorCacheEntry {
+    Accumulator accumulator;
+    FeatureBitboards features{};
+
+    // Number of feature rows that refreshing this entry to the given features would touch
+    [[nodiscard]] usize distance(const FeatureBitboards &new_features) const {
+        const auto [num_changed, num_active] = count_rows(new_features);
+        return std::min(num_changed, num_active);
+    }
+
+    // Calls sub(accumulator, defended, threatened, enemy, piece, sq) for every cached feature missing from the new
+    // features and add(...) for every new feature missing from the cache. If diffing would touch more rows than
+    // rebuilding the accumulator from scratch, reset(accumulator) is called first so only the new features are added.
+    template <typename Add, typename Sub, typename Reset>
+    void refresh(const FeatureBitboards &new_features, Add &&add, Sub &&sub, Reset &&reset) {
+        const auto [num_changed, num_active] = count_rows(new_features);
+        if (num_changed > num_active) {
+            reset(accumulator);
+            features = {};
+        }
+
+        for_each_plane([&](usize defended, usize threatened, usize enemy, usize piece) {
+            const auto old_bb = features[defended][threatened][enemy][piece];
+            const auto new_bb = new_features[defended][threatened][enemy][piece];
+            for (const auto sq : old_bb & ~new_bb) {
+                sub(accumulator, defended, threatened, enemy, piece, sq);
+            }
+            for (const auto sq : new_bb & ~old_bb) {
+                add(accumulator, defended, threatened, enemy, piece, sq);
+            }
+        });
+        features = new_features;
+    }
+
+    // Drops the cached features, for example after the network the accumulator was built with has been replaced
+    template <typename Reset>
+    void clear(Reset &&reset) {
+        reset(accumulator);
+        features = {};
+    }
+
+  private:
+    // Number of features that differ from the cached ones, and number of active new features
+    [[nodiscard]] std::pair<usize, usize> count_rows(const FeatureBitboards &new_features) const {
+        usize num_changed = 0, num_active = 0;
+        for_each_plane([&](usize defended, usize threatened, usize enemy, usize piece) {
+            const auto new_bb = new_features[defended][threatened][enemy][piece];
+            num_changed += (features[defended][threatened][enemy][piece] ^ new_bb).pop_count();
+            num_active += new_bb.pop_count();
+        });
+        return {num_changed, num_active};
+    }
+
+    template <typename Fn>
+    static void for_each_plane(Fn &&fn) {
+        for (usize defended = 0; defended < 2; ++defended) {
+            for (usize threatened = 0; threatened < 2; ++threatened) {
+                for (usize enemy = 0; enemy < 2; ++enemy) {
+                    for (usize piece = 0; piece < 6; ++piece) {
+                        fn(defended, threatened, enemy, piece);
+                    }
+                }
+            }
+        }
+    }
+};
+
+// The last few accumulators computed for one [perspective][king mirrored] bucket. Positions evaluated one after another
+// are spread over the tree, so a single entry is often far from the next position, while one of the last few usually
+// belongs to its parent or a sibling. A refresh starts from the closest entry and writes the result over the least
+// recently used one, so the accumulators of the parent and its siblings stay around for the next expansions.
+template <typename Accumulator, usize N>
+class AccumulatorCacheBucket {
+  public:
+    template <typename Add, typename Sub, typename Reset>
+    const Accumulator &refresh(const FeatureBitboards &features, Add &&add, Sub &&sub, Reset &&reset) {
+        usize closest = 0, closest_distance = std::numeric_limits<usize>::max();
+        for (usize i = 0; i < N; ++i) {
+            const auto distance = entries_[i].distance(features);
+            if (distance < closest_distance) {
+                closest = i, closest_distance = distance;
+            }
+        }
+
+        // Refreshing the closest entry in place would lose it, so it is copied over the oldest entry first unless
+        // it is the oldest. Exact matches are reused without copying.
+        usize target = closest;
+        if (closest_distance > 0) {
+            target = static_cast<usize>(std::min_element(last_used_.begin(), last_used_.end()) - last_used_.begin());
+            if (target != closest) {
+                entries_[target] = entries_[closest];
+            }
+        }
+
+        entries_[target].refresh(features, add, sub, reset);
+        last_used_[target] = ++clock_;
+        return entries_[target].accumulator;
+    }
+
+    template <typename Reset>
+    void clear(Reset &&reset) {
+        for (auto &entry : entries_) {
+            entry.clear(reset);
+        }
+        last_used_ = {};
+        clock_ = 0;
+    }
+
+  private:
+    std::array<AccumulatorCacheEntry<Accumulator>, N> entries_;
+    std::array<u64, N> last_used_{};
+    u64 clock_ = 0;
+};
+
+// One bucket per [perspective][king mirrored], kept per thread by the networks using it
+template <typename Accumulator, usize N = 8>
+using AccumulatorCache = util::MultiArray<AccumulatorCacheBucket<Accumulator, N>, 2, 2>;
+
+} // namespace network
+
+#endif // ACCUMULATOR_CACHE_HPP
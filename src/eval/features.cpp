@@ -0,0 +1,45 @@
+#include "features.hpp"
+
+namespace network {
+
+namespace {
+
+void split_planes(FeatureBitboards &features, usize enemy, usize piece, Bitboard pieces, Bitboard defended,
+                  Bitboard threatened) {
+    features[1][1][enemy][piece] = pieces & defended & threatened;
+    features[1][0][enemy][piece] = pieces & defended & ~threatened;
+    features[0][1][enemy][piece] = pieces & ~defended & threatened;
+    features[0][0][enemy][piece] = pieces & ~defended & ~threatened;
+}
+
+} // namespace
+
+PositionFeatures extract_features(const BoardState &state) {
+    PositionFeatures res;
+    const auto stm = state.side_to_move;
+    res.side_to_move = stm;
+    res.king_sq = state.king(stm).lsb();
+    res.mirrored = res.king_sq.file() >= File::E;
+    res.flip = 0b111000 * stm ^ 0b000111 * res.mirrored;
+
+    // The value and policy features both come from the same threat maps, which are only computed once here
+    const auto threats = state.compute_threats();
+    const auto policy_defended = threats.threats[stm];
+    const auto policy_threatened = threats.threats[~stm];
+
+    for (usize enemy = 0; enemy < 2; ++enemy) {
+        const auto color = enemy ? ~stm : stm;
+        // Pieces are threatened by the other side and defended by their own
+        const auto value_defended = threats.pinned_threats[color];
+        const auto value_threatened = threats.pinned_threats[~color];
+        for (usize piece = 0; piece < 6; ++piece) {
+            const auto pieces = state.piece_bbs[piece] & state.occupancy(color);
+            split_planes(res.value, enemy, piece, pieces, value_defended, value_threatened);
+            split_planes(res.policy, enemy, piece, pieces, policy_defended, policy_threatened);
+        }
+    }
+
+    return res;
+}
+
+} // namespace network
@@ -0,0 +1,32 @@
+#ifndef FEATURES_HPP
+#define FEATURES_HPP
+
+#include "../chess/board_state.hpp"
+#include "../util/multi_array.hpp"
+
+namespace network {
+
+// Squares of every active feature, split into the [defended][threatened][enemy][piece] planes of the feature
+// transformers. Viewed from a fixed perspective and king mirror, a plane maps one-to-one onto feature transformer rows.
+using FeatureBitboards = util::MultiArray<Bitboard, 2, 2, 2, 6>;
+
+// Everything the value and policy networks read from a position, extracted in a single pass over its pieces so that
+// a position seen by both networks is only walked once
+struct PositionFeatures {
+    Color side_to_move;
+    Square king_sq;
+    // Whether the side to move's king is on the e-h files, which selects the horizontally mirrored accumulator
+    bool mirrored;
+    // Xor that maps a square onto the feature transformer rows of the side to move and king mirror
+    usize flip;
+    // The value network only counts attacks that pinned pieces can actually make. The policy network counts every
+    // attack, and sees all pieces as threatened by the opponent and defended by the side to move.
+    FeatureBitboards value;
+    FeatureBitboards policy;
+};
+
+[[nodiscard]] PositionFeatures extract_features(const BoardState &state);
+
+} // namespace network
+
+#endif // FEATURES_HPP
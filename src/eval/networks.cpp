@@ -1,49 +1,434 @@
+#include "networks.hpp"
 #include "../third_party/incbin.h"
-#include "policy_network.hpp"
-#include "value_network.hpp"
+#include "../util/mapped_file.hpp"
+#include "policy_kernels.hpp"
+#include "value_kernels.hpp"
 
-namespace network {
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
 
-#ifdef EVALFILE
+namespace network {
 
 namespace detail {
 
-struct CombinedNetworks {
-    value::ValueNetwork value_net;
-    alignas(64) policy::PolicyNetwork policy_net;
+enum class NetworkKind : u16 {
+    VALUE,
+    POLICY,
 };
-INCBIN(COMBINEDNETWORKS, EVALFILE);
-const auto combined_networks = reinterpret_cast<const CombinedNetworks *>(gCOMBINEDNETWORKSData);
 
-} // namespace detail
+// Written in front of the weights of a network by tools/concat_networks.py, which has to be kept in sync with it. The
+// weights follow right after, so the header is 64 bytes long to keep them aligned.
+struct NetworkHeader {
+    u32 magic;
+    u16 version;
+    NetworkKind kind;
+    std::array<u32, 4> layer_sizes;
+    std::array<i32, 2> quantisation;
+    u64 weights_size;
+    u32 checksum; // crc32 of the weights
+    u16 flags;
+    std::array<u8, 18> reserved;
+};
+static_assert(sizeof(NetworkHeader) == 64);
 
-namespace value {
+constexpr u32 MAGIC = 0x454E4956; // "VINE" read as a little endian u32
+constexpr u16 VERSION = 1;
 
-extern const auto network = &detail::combined_networks->value_net;
+// The feature transformer weights of a value network are stored as i8, see NarrowNetwork
+constexpr u16 NARROW_FT_WEIGHTS = 1;
 
-} // namespace value
+// Number of [defended][threatened][enemy][piece][square] inputs to the feature transformers
+constexpr u32 NUM_FEATURES = 2 * 2 * 2 * 6 * 64;
 
-namespace policy {
+template <typename Network>
+constexpr NetworkHeader EXPECTED_HEADER{};
 
-extern const auto network = &detail::combined_networks->policy_net;
+template <typename Arch>
+constexpr NetworkHeader EXPECTED_HEADER<value::Network<Arch>> = {
+    MAGIC,
+    VERSION,
+    NetworkKind::VALUE,
+    {NUM_FEATURES, Arch::L1_SIZE, Arch::L2_SIZE, Arch::L3_SIZE},
+    {value::QA, value::QB},
+    sizeof(value::Network<Arch>),
+    0,
+    0,
+    {},
+};
 
-} // namespace policy
+template <typename Arch>
+constexpr NetworkHeader EXPECTED_HEADER<policy::Network<Arch>> = {
+    MAGIC,
+    VERSION,
+    NetworkKind::POLICY,
+    {NUM_FEATURES, Arch::L1_SIZE, policy::OUTPUT_SIZE, 0},
+    {policy::Q, 0},
+    sizeof(policy::Network<Arch>),
+    0,
+    0,
+    {},
+};
+
+[[nodiscard]] std::string kind_name(NetworkKind kind) {
+    return kind == NetworkKind::VALUE ? "value" : "policy";
+}
+
+template <typename T, usize N>
+[[nodiscard]] std::string join(const std::array<T, N> &values) {
+    std::string res;
+    for (usize i = 0; i < N; ++i) {
+        res += (i ? "x" : "") + std::to_string(values[i]);
+    }
+    return res;
+}
+
+// The same crc32 as zlib's, so the tools can compute it with the python standard library. Uses slicing-by-8, which
+// goes through 8 bytes per step with one table per byte instead of one byte at a time.
+[[nodiscard]] u32 crc32(const u8 *data, usize size) {
+    static constexpr auto TABLES = [] {
+        std::array<std::array<u32, 256>, 8> tables{};
+        for (u32 i = 0; i < 256; ++i) {
+            u32 crc = i;
+            for (i32 bit = 0; bit < 8; ++bit) {
+                crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+            }
+            tables[0][i] = crc;
+        }
+        // tables[k][i] is the crc of byte i followed by k zero bytes
+        for (usize k = 1; k < tables.size(); ++k) {
+            for (u32 i = 0; i < 256; ++i) {
+                tables[k][i] = tables[0][tables[k - 1][i] & 0xFF] ^ (tables[k - 1][i] >> 8);
+            }
+        }
+        return tables;
+    }();
+
+    u32 crc = ~0u;
+    usize i = 0;
+    for (; i + 8 <= size; i += 8) {
+        u64 chunk;
+        std::memcpy(&chunk, data + i, sizeof(chunk));
+        chunk ^= crc;
+        crc = TABLES[7][chunk & 0xFF] ^ TABLES[6][(chunk >> 8) & 0xFF] ^ TABLES[5][(chunk >> 16) & 0xFF] ^
+              TABLES[4][(chunk >> 24) & 0xFF] ^ TABLES[3][(chunk >> 32) & 0xFF] ^ TABLES[2][(chunk >> 40) & 0xFF] ^
+              TABLES[1][(chunk >> 48) & 0xFF] ^ TABLES[0][chunk >> 56];
+    }
+    for (; i < size; ++i) {
+        crc = TABLES[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Size of the weights of a network when its feature transformer weights are narrowed to i8, or 0 for the kinds that
+// never are
+template <typename Network>
+constexpr u64 NARROW_WEIGHTS_SIZE = 0;
+
+template <typename Arch>
+constexpr u64 NARROW_WEIGHTS_SIZE<value::Network<Arch>> = sizeof(value::NarrowNetwork<Arch>);
+
+// A network found at the start of some data, a Network<Arch> of the architecture at the given index of the kind's
+// Architectures or its narrowed counterpart, along with the number of bytes it takes up including its header
+struct Section {
+    const void *network;
+    usize architecture;
+    usize size;
+    bool narrow = false;
+    // Owns the network when it had to be copied out of the data, see padded_copy
+    std::shared_ptr<const void> padded;
+};
+
+// Copies a network that is missing some of its padding into a zero padded buffer with the alignment it needs
+[[nodiscard]] std::shared_ptr<const void> padded_copy(const u8 *data, usize size, usize padded_size) {
+    constexpr auto ALIGNMENT = std::align_val_t{64};
+    auto *buffer = static_cast<u8 *>(::operator new(padded_size, ALIGNMENT));
+    std::memcpy(buffer, data, size);
+    std::memset(buffer + size, 0, padded_size - size);
+    return std::shared_ptr<const void>(buffer, [](u8 *ptr) { ::operator delete(ptr, ALIGNMENT); });
+}
+
+// The headers of every architecture of a kind, in the order of its Architectures
+template <template <typename> typename Network, typename... Archs>
+[[nodiscard]] constexpr std::array<NetworkHeader, sizeof...(Archs)> expected_headers(std::tuple<Archs...>) {
+    return {EXPECTED_HEADER<Network<Archs>>...};
+}
+
+template <template <typename> typename Network, typename... Archs>
+[[nodiscard]] constexpr std::array<u64, sizeof...(Archs)> narrow_weights_sizes(std::tuple<Archs...>) {
+    return {NARROW_WEIGHTS_SIZE<Network<Archs>>...};
+}
+
+// Finds the network at the start of the data, picking the architecture its header asks for among the ones this binary
+// was built with. Files from before headers existed are still accepted as the default architecture, but only their
+// size can be checked. Trainers may leave out the padding at the end of such a network, which is filled back in when
+// nothing follows it, the same as tools/concat_networks.py does. The checksum is only worth verifying for files read at
+// runtime, as the embedded networks are fixed by the build and checking them would read all of them at every startup.
+template <template <typename> typename Network, typename Architectures>
+[[nodiscard]] std::optional<std::string> parse_section(const u8 *data, usize size, bool more_follow,
+                                                       bool verify_checksum, Section &section) {
+    constexpr auto EXPECTED = expected_headers<Network>(Architectures{});
+    constexpr auto NARROW_SIZES = narrow_weights_sizes<Network>(Architectures{});
+    const auto kind = EXPECTED[0].kind;
+    const auto default_size = EXPECTED[0].weights_size;
+
+    NetworkHeader header{};
+    if (size >= sizeof(header)) {
+        std::memcpy(&header, data, sizeof(header));
+    }
+
+    if (header.magic != MAGIC) {
+        if (more_follow ? size < default_size : (size <= default_size - 64 || size > default_size)) {
+            return "headerless " + kind_name(kind) + " network is " + std::to_string(size) + " bytes, expected " +
+                   std::to_string(default_size);
+        }
+        if (size < default_size) {
+            auto padded = padded_copy(data, size, default_size);
+            section = {padded.get(), 0, size, false, std::move(padded)};
+        } else {
+            section = {data, 0, default_size};
+        }
+        return std::nullopt;
+    }
+
+    if (header.version != VERSION) {
+        return "unsupported network file version " + std::to_string(header.version) + ", expected " +
+               std::to_string(VERSION);
+    }
+    if (header.kind != kind) {
+        return "expected a " + kind_name(kind) + " network, got a " + kind_name(header.kind) + " network";
+    }
+
+    const auto architecture = static_cast<usize>(
+        std::find_if(EXPECTED.begin(), EXPECTED.end(),
+                     [&](const NetworkHeader &expected) { return expected.layer_sizes == header.layer_sizes; }) -
+        EXPECTED.begin());
+    if (architecture == EXPECTED.size()) {
+        std::string supported;
+        for (const auto &expected : EXPECTED) {
+            supported += (supported.empty() ? "" : ", ") + join(expected.layer_sizes);
+        }
+        return kind_name(kind) + " network has layer sizes " + join(header.layer_sizes) + ", supported are " +
+               supported;
+    }
+
+    const auto &expected = EXPECTED[architecture];
+    if (header.quantisation != expected.quantisation) {
+        return kind_name(kind) + " network has quantisation constants " + join(header.quantisation) + ", expected " +
+               join(expected.quantisation);
+    }
+    if ((header.flags & ~NARROW_FT_WEIGHTS) != 0) {
+        return kind_name(kind) + " network has unknown flags " + std::to_string(header.flags);
+    }
+    const bool narrow = (header.flags & NARROW_FT_WEIGHTS) != 0;
+    if (narrow && NARROW_SIZES[architecture] == 0) {
+        return kind_name(kind) + " networks can't have narrowed feature transformer weights";
+    }
+    const auto weights_size = narrow ? NARROW_SIZES[architecture] : expected.weights_size;
+    if (header.weights_size != weights_size) {
+        return kind_name(kind) + " network has " + std::to_string(header.weights_size) +
+               " bytes of weights, expected " + std::to_string(weights_size);
+    }
+    if (size < sizeof(header) + weights_size) {
+        return kind_name(kind) + " network is truncated";
+    }
+    if (verify_checksum && crc32(data + sizeof(header), weights_size) != header.checksum) {
+        return kind_name(kind) + " network checksum mismatch, the file is corrupted";
+    }
+
+    section = {data + sizeof(header), architecture, sizeof(header) + weights_size, narrow};
+    return std::nullopt;
+}
 
+[[nodiscard]] std::optional<std::string> parse_value_section(const u8 *data, usize size, bool more_follow,
+                                                             bool verify_checksum, Section &section) {
+    return parse_section<value::Network, value::Architectures>(data, size, more_follow, verify_checksum, section);
+}
+
+[[nodiscard]] std::optional<std::string> parse_policy_section(const u8 *data, usize size, bool verify_checksum,
+                                                              Section &section) {
+    return parse_section<policy::Network, policy::Architectures>(data, size, false, verify_checksum, section);
+}
+
+[[nodiscard]] std::optional<std::string> parse_combined(const u8 *data, usize size, bool verify_checksum,
+                                                        Section &value_section, Section &policy_section) {
+    if (const auto error = parse_value_section(data, size, true, verify_checksum, value_section)) {
+        return error;
+    }
+    return parse_policy_section(data + value_section.size, size - value_section.size, verify_checksum,
+                                policy_section);
+}
+
+#ifdef EVALFILE
+INCBIN(COMBINEDNETWORKS, EVALFILE);
 #else
+INCBIN(VALUENETWORK, VALUEFILE);
+INCBIN(POLICYNETWORK, POLICYFILE);
+#endif
+
+struct EmbeddedNetworks {
+    Section value;
+    Section policy;
+};
+
+// The embedded networks are validated like any file apart from their checksum, but a mismatch there means the binary
+// was built wrong
+[[nodiscard]] const EmbeddedNetworks &embedded_networks() {
+    static const EmbeddedNetworks networks = [] {
+        EmbeddedNetworks res{};
+#ifdef EVALFILE
+        auto error = parse_combined(gCOMBINEDNETWORKSData, gCOMBINEDNETWORKSSize, false, res.value, res.policy);
+#else
+        auto error = parse_value_section(gVALUENETWORKData, gVALUENETWORKSize, false, false, res.value);
+        if (!error) {
+            error = parse_policy_section(gPOLICYNETWORKData, gPOLICYNETWORKSize, false, res.policy);
+        }
+#endif
+        if (error) {
+            std::cerr << "embedded network: " << *error << std::endl;
+            std::exit(1);
+        }
+        return res;
+    }();
+    return networks;
+}
+
+// Memory backing the active networks, which has to stay alive for as long as they are in use. This is the mapped file,
+// or the padded copy of a network that needed one. Both point to the same mapping when a combined file is loaded.
+std::shared_ptr<const void> value_file, policy_file;
+
+// Read by every thread that evaluates positions. The networks themselves are only swapped while no search or datagen
+// is running, which the uci loop guarantees by handling setoption on the thread that runs them.
+std::atomic<u32> current_generation = 0;
+
+// What has to be kept alive for a section's network to stay valid
+[[nodiscard]] std::shared_ptr<const void> backing(const Section &section,
+                                                  const std::shared_ptr<const util::MappedFile> &file) {
+    if (section.padded) {
+        return section.padded;
+    }
+    return file;
+}
+
+[[nodiscard]] std::optional<std::string> map(std::string_view path, std::shared_ptr<const util::MappedFile> &file) {
+    auto mapped = util::MappedFile::open(std::string(path));
+    if (!mapped) {
+        return "failed to open " + std::string(path);
+    }
+    file = std::make_shared<const util::MappedFile>(std::move(*mapped));
+    return std::nullopt;
+}
+
+// Lets everything derived from the weights know that they changed, and has the kernels lay out the new weights the
+// way they prefer up front rather than in the middle of a search
+void networks_changed() {
+    current_generation.fetch_add(1, std::memory_order_release);
+    value::prepare();
+    policy::prepare();
+}
+
+// Whether a section is the network that is already active and prepared. Every network option loads its default when it
+// is created, so without this check startup would prepare the embedded networks once per option.
+template <typename ActiveNetwork>
+[[nodiscard]] bool already_active(const ActiveNetwork &active, const Section &section) {
+    return current_generation.load(std::memory_order_acquire) != 0 && active.weights == section.network &&
+           active.architecture == section.architecture;
+}
+
+} // namespace detail
 
 namespace value {
 
-INCBIN(VALUENETWORK, VALUEFILE);
-extern const auto network = reinterpret_cast<const ValueNetwork *>(gVALUENETWORKData);
+ActiveNetwork &active_network() {
+    static ActiveNetwork network = {detail::embedded_networks().value.network,
+                                    detail::embedded_networks().value.architecture,
+                                    detail::embedded_networks().value.narrow};
+    return network;
+}
 
 } // namespace value
 
 namespace policy {
 
-INCBIN(POLICYNETWORK, POLICYFILE);
-extern const auto network = reinterpret_cast<const PolicyNetwork *>(gPOLICYNETWORKData);
+ActiveNetwork &active_network() {
+    static ActiveNetwork network = {detail::embedded_networks().policy.network,
+                                    detail::embedded_networks().policy.architecture};
+    return network;
+}
+
 } // namespace policy
 
-#endif
+std::optional<std::string> load_value_network(std::string_view path) {
+    detail::Section section = detail::embedded_networks().value;
+    std::shared_ptr<const util::MappedFile> file;
+    if (path != EMBEDDED) {
+        if (const auto error = detail::map(path, file)) {
+            return error;
+        }
+        if (const auto error = detail::parse_value_section(file->data(), file->size(), false, true, section)) {
+            return std::string(path) + ": " + *error;
+        }
+    }
+    const bool unchanged = detail::already_active(value::active_network(), section);
+    value::active_network() = {section.network, section.architecture, section.narrow};
+    detail::value_file = detail::backing(section, file);
+    if (!unchanged) {
+        detail::networks_changed();
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string> load_policy_network(std::string_view path) {
+    detail::Section section = detail::embedded_networks().policy;
+    std::shared_ptr<const util::MappedFile> file;
+    if (path != EMBEDDED) {
+        if (const auto error = detail::map(path, file)) {
+            return error;
+        }
+        if (const auto error = detail::parse_policy_section(file->data(), file->size(), true, section)) {
+            return std::string(path) + ": " + *error;
+        }
+    }
+    const bool unchanged = detail::already_active(policy::active_network(), section);
+    policy::active_network() = {section.network, section.architecture};
+    detail::policy_file = detail::backing(section, file);
+    if (!unchanged) {
+        detail::networks_changed();
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string> load_combined_networks(std::string_view path) {
+    detail::Section value_section = detail::embedded_networks().value;
+    detail::Section policy_section = detail::embedded_networks().policy;
+    std::shared_ptr<const util::MappedFile> file;
+    if (path != EMBEDDED) {
+        if (const auto error = detail::map(path, file)) {
+            return error;
+        }
+        if (const auto error =
+                detail::parse_combined(file->data(), file->size(), true, value_section, policy_section)) {
+            return std::string(path) + ": " + *error;
+        }
+    }
+    const bool unchanged = detail::already_active(value::active_network(), value_section) &&
+                           detail::already_active(policy::active_network(), policy_section);
+    value::active_network() = {value_section.network, value_section.architecture, value_section.narrow};
+    policy::active_network() = {policy_section.network, policy_section.architecture};
+    detail::value_file = detail::backing(value_section, file);
+    detail::policy_file = detail::backing(policy_section, file);
+    if (!unchanged) {
+        detail::networks_changed();
+    }
+    return std::nullopt;
+}
+
+u32 generation() {
+    return detail::current_generation.load(std::memory_order_acquire);
+}
 
 } // namespace network
@@ -0,0 +1,52 @@
+#ifndef NETWORKS_HPP
+#define NETWORKS_HPP
+
+#include "../util/types.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace network {
+
+// Option value that selects the networks embedded in the binary
+constexpr std::string_view EMBEDDED = "<embedded>";
+
+// Memory map a value, policy or combined network file, check its header against the architecture this binary was built
+// for and make it the active network. On failure the active network is left untouched and an error message is returned.
+[[nodiscard]] std::optional<std::string> load_value_network(std::string_view path);
+[[nodiscard]] std::optional<std::string> load_policy_network(std::string_view path);
+[[nodiscard]] std::optional<std::string> load_combined_networks(std::string_view path);
+
+// Incremented whenever a network is loaded, so anything derived from the weights knows to rebuild itself
+[[nodiscard]] u32 generation();
+
+// Data derived from the active networks, such as weights rearranged for a kernel. It is rebuilt the first time it is
+// needed after a network has been loaded, and safe to request from several threads at once.
+template <typename T>
+class DerivedData {
+  public:
+    template <typename Build>
+    [[nodiscard]] const T &get(Build &&build) {
+        const auto current = generation();
+        if (generation_.load(std::memory_order_acquire) != current) {
+            std::lock_guard lock(mutex_);
+            if (generation_.load(std::memory_order_relaxed) != current) {
+                build(data_);
+                generation_.store(current, std::memory_order_release);
+            }
+        }
+        return data_;
+    }
+
+  private:
+    T data_;
+    std::atomic<u32> generation_ = ~0u;
+    std::mutex mutex_;
+};
+
+} // namespace network
+
+#endif // NETWORKS_HPP
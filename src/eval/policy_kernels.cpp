@@ -0,0 +1,172 @@
+#include "../util/simd.hpp"
+#include "policy_kernels.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+namespace network::policy {
+
+// Everything in here is compiled once per instruction set in dispatch builds, see value_kernels.cpp
+namespace CPU_ISA {
+
+namespace {
+
+constexpr usize VECTOR_SIZE = util::NATIVE_SIZE<i16>;
+
+template <typename Arch>
+void add_feature(Accumulator<Arch> &accumulator, const i8 *weights) {
+    for (usize i = 0; i < Arch::L1_SIZE; i += VECTOR_SIZE) {
+        const auto sum = util::loadu<i16, VECTOR_SIZE>(accumulator.values.data() + i) +
+                         util::convert_vector<i16, i8, VECTOR_SIZE>(util::loadu<i8, VECTOR_SIZE>(weights + i));
+        util::storeu<i16, VECTOR_SIZE>(accumulator.values.data() + i, sum);
+    }
+}
+
+template <typename Arch>
+void sub_feature(Accumulator<Arch> &accumulator, const i8 *weights) {
+    for (usize i = 0; i < Arch::L1_SIZE; i += VECTOR_SIZE) {
+        const auto diff = util::loadu<i16, VECTOR_SIZE>(accumulator.values.data() + i) -
+                          util::convert_vector<i16, i8, VECTOR_SIZE>(util::loadu<i8, VECTOR_SIZE>(weights + i));
+        util::storeu<i16, VECTOR_SIZE>(accumulator.values.data() + i, diff);
+    }
+}
+
+// Products of two values clamped to [0, Q] are divided by Q to fit in a u8
+constexpr i16 ACTIVATION_SHIFT = 7;
+static_assert(1 << ACTIVATION_SHIFT == Q && Q <= 128);
+
+template <typename Arch>
+void activate(const Accumulator<Arch> &accumulator, u8 *activated) {
+    for (usize i = 0; i < Arch::L1_SIZE / 2; i += VECTOR_SIZE) {
+        const auto first = util::loadu<i16, VECTOR_SIZE>(accumulator.values.data() + i);
+        const auto second = util::loadu<i16, VECTOR_SIZE>(accumulator.values.data() + i + Arch::L1_SIZE / 2);
+        const auto first_clamped = util::clamp_scalar<i16, VECTOR_SIZE>(first, 0, Q);
+        const auto second_clamped = util::clamp_scalar<i16, VECTOR_SIZE>(second, 0, Q);
+        const auto product = (first_clamped * second_clamped) >> ACTIVATION_SHIFT;
+        util::storeu<u8, VECTOR_SIZE>(activated + i, util::convert_vector<u8, i16, VECTOR_SIZE>(product));
+    }
+}
+
+#if defined(__SSSE3__)
+
+constexpr usize DOT_VECTOR_SIZE = util::NATIVE_SIZE<u8>;
+using DotInputs = util::SimdVector<u8, DOT_VECTOR_SIZE>;
+using DotWeights = util::SimdVector<i8, DOT_VECTOR_SIZE>;
+using DotSum = util::SimdVector<i32, DOT_VECTOR_SIZE / 4>;
+
+DotInputs load_inputs(const u8 *activated) {
+    return util::loadu<u8, DOT_VECTOR_SIZE>(activated);
+}
+
+DotWeights load_weights(const i8 *weights) {
+    return util::loadu<i8, DOT_VECTOR_SIZE>(weights);
+}
+
+std::array<DotWeights, 2> load_packed_weights(const u8 *packed) {
+    const auto bytes = util::loadu<u8, DOT_VECTOR_SIZE>(packed);
+    return {util::convert_vector<i8, u8, DOT_VECTOR_SIZE>(bytes & 0x0F) - 8,
+            util::convert_vector<i8, u8, DOT_VECTOR_SIZE>(bytes >> 4) - 8};
+}
+
+// Activations are at most Q = 128, so the i16 pair sums of maddubs can't saturate when dpbusd is emulated
+DotSum dot_step(DotSum sum, DotInputs inputs, DotWeights weights) {
+    return util::dpbusd_epi32(sum, inputs, weights);
+}
+
+#else
+
+constexpr usize DOT_VECTOR_SIZE = VECTOR_SIZE;
+using DotInputs = util::SimdVector<i16, DOT_VECTOR_SIZE>;
+using DotWeights = util::SimdVector<i16, DOT_VECTOR_SIZE>;
+using DotSum = util::SimdVector<i32, DOT_VECTOR_SIZE / 2>;
+
+DotInputs load_inputs(const u8 *activated) {
+    return util::convert_vector<i16, u8, DOT_VECTOR_SIZE>(util::loadu<u8, DOT_VECTOR_SIZE>(activated));
+}
+
+DotWeights load_weights(const i8 *weights) {
+    return util::convert_vector<i16, i8, DOT_VECTOR_SIZE>(util::loadu<i8, DOT_VECTOR_SIZE>(weights));
+}
+
+std::array<DotWeights, 2> load_packed_weights(const u8 *packed) {
+    const auto bytes = util::convert_vector<i16, u8, DOT_VECTOR_SIZE>(util::loadu<u8, DOT_VECTOR_SIZE>(packed));
+    return {(bytes & 0x0F) - 8, (bytes >> 4) - 8};
+}
+
+DotSum dot_step(DotSum sum, DotInputs inputs, DotWeights weights) {
+    return sum + util::madd_epi16(inputs, weights);
+}
+
+#endif
+
+static_assert(PACKED_BLOCK_SIZE % DOT_VECTOR_SIZE == 0);
+
+// Number of output rows computed together, sharing every load of the activations
+constexpr usize DOT_GROUP_SIZE = 4;
+
+// Reduced by hand, since std::reduce over vectors would be shared with other instruction sets' copies of this file
+template <usize ROWS>
+void reduce_sums(const std::array<DotSum, ROWS> &sum, i32 *out) {
+    for (usize r = 0; r < ROWS; ++r) {
+        out[r] = util::reduce_vector<i32, sizeof(DotSum) / sizeof(i32)>(sum[r]);
+    }
+}
+
+// Dot products with a group of rows, while prefetching the rows of the next group
+template <typename Arch, usize ROWS>
+void dot_group(const u8 *activated, const i8 *const *rows, const i8 *const *next_rows, i32 *out) {
+    std::array<DotSum, ROWS> sum{};
+    for (usize i = 0; i < Arch::L1_SIZE / 2; i += DOT_VECTOR_SIZE) {
+        const auto inputs = load_inputs(activated + i);
+        for (usize r = 0; r < ROWS; ++r) {
+            __builtin_prefetch(next_rows[r] + i);
+            sum[r] = dot_step(sum[r], inputs, load_weights(rows[r] + i));
+        }
+    }
+    reduce_sums<ROWS>(sum, out);
+}
+
+// The same for packed rows. Every byte loaded holds the weights of two activations, 64 apart.
+template <typename Arch, usize ROWS>
+void dot_group(const u8 *activated, const PackedRow<Arch> *const *rows, const PackedRow<Arch> *const *next_rows,
+               i32 *out) {
+    std::array<DotSum, ROWS> sum{};
+    for (usize block = 0; block < std::tuple_size_v<PackedRow<Arch>>; block += PACKED_BLOCK_SIZE) {
+        for (usize i = block; i < block + PACKED_BLOCK_SIZE; i += DOT_VECTOR_SIZE) {
+            const auto low_inputs = load_inputs(activated + block + i);
+            const auto high_inputs = load_inputs(activated + block + i + PACKED_BLOCK_SIZE);
+            for (usize r = 0; r < ROWS; ++r) {
+                __builtin_prefetch(next_rows[r]->data() + i);
+                const auto [low, high] = load_packed_weights(rows[r]->data() + i);
+                sum[r] = dot_step(dot_step(sum[r], low_inputs, low), high_inputs, high);
+            }
+        }
+    }
+    reduce_sums<ROWS>(sum, out);
+}
+
+template <typename Arch, typename Row>
+void dot_rows(const u8 *activated, const Row *const *rows, usize count, i32 *out) {
+    usize i = 0;
+    for (; i + DOT_GROUP_SIZE <= count; i += DOT_GROUP_SIZE) {
+        // The last group prefetches its own rows, which are already in cache by then
+        const auto next = i + 2 * DOT_GROUP_SIZE <= count ? i + DOT_GROUP_SIZE : i;
+        dot_group<Arch, DOT_GROUP_SIZE>(activated, rows + i, rows + next, out + i);
+    }
+    for (; i < count; ++i) {
+        dot_group<Arch, 1>(activated, rows + i, rows + i, out + i);
+    }
+}
+
+template <typename Arch>
+constexpr Kernels<Arch> KERNELS_OF = {add_feature<Arch>, sub_feature<Arch>, activate<Arch>, dot_rows<Arch, i8>,
+                                      dot_rows<Arch, PackedRow<Arch>>};
+
+} // namespace
+
+extern const KernelSet KERNELS = std::apply([](auto... archs) { return KernelSet{KERNELS_OF<decltype(archs)>...}; },
+                                            Architectures{});
+
+} // namespace CPU_ISA
+
+} // namespace network::policy
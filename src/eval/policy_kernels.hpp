@@ -0,0 +1,58 @@
+#ifndef POLICY_KERNELS_HPP
+#define POLICY_KERNELS_HPP
+
+#include "policy_network.hpp"
+
+#include <array>
+
+namespace network::policy {
+
+// The loaded network, a Network<Arch> of the architecture at the given index of Architectures
+struct ActiveNetwork {
+    const void *weights;
+    usize architecture;
+};
+
+// Starts out as the embedded network, see value::active_network
+[[nodiscard]] ActiveNetwork &active_network();
+
+template <typename Arch>
+struct alignas(64) Accumulator {
+    std::array<i16, Arch::L1_SIZE> values;
+};
+
+// Output weights quantised to 4 bits and packed two to a byte, offset by 8 so they are stored as 0 to 15. Each block of
+// 64 bytes holds the weights of 128 activations: the first 64 in the low nibbles and the next 64 in the high nibbles.
+constexpr usize PACKED_BLOCK_SIZE = 64;
+template <typename Arch>
+using PackedRow = std::array<u8, Arch::L1_SIZE / 4>;
+
+// The instruction set specific parts of the policy network. Dispatch builds compile policy_kernels.cpp once per
+// instruction set and pick one set of kernels at startup.
+template <typename Arch>
+struct Kernels {
+    // Adds or subtracts one row of feature transformer weights
+    void (*add_feature)(Accumulator<Arch> &accumulator, const i8 *weights);
+    void (*sub_feature)(Accumulator<Arch> &accumulator, const i8 *weights);
+    // Clamps both halves of the accumulator, multiplies them together and scales the products down by Q
+    void (*activate)(const Accumulator<Arch> &accumulator, u8 *activated);
+    // Dot products of the activations with count rows of output weights
+    void (*dot_rows)(const u8 *activated, const i8 *const *rows, usize count, i32 *out);
+    // The same for packed rows, unpacking them in registers
+    void (*dot_packed_rows)(const u8 *activated, const PackedRow<Arch> *const *rows, usize count, i32 *out);
+};
+
+// The kernels of every architecture, in the order of Architectures
+template <typename... Archs>
+std::tuple<Kernels<Archs>...> kernel_set_of(std::tuple<Archs...>);
+using KernelSet = decltype(kernel_set_of(Architectures{}));
+
+template <typename Arch>
+[[nodiscard]] const Kernels<Arch> &kernels();
+
+// Builds everything derived from a newly loaded policy network
+void prepare();
+
+} // namespace network::policy
+
+#endif // POLICY_KERNELS_HPP
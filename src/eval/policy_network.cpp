@@ -1,26 +1,58 @@
 #include "policy_network.hpp"
 #include "../chess/move_gen.hpp"
+#include "../util/assert.hpp"
+#include "../util/cpu.hpp"
+#include "accumulator_cache.hpp"
+#include "networks.hpp"
+#include "policy_kernels.hpp"
 
-#include "../third_party/incbin.h"
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstring>
-#include <iostream>
-#include <numeric>
 
 namespace network::policy {
 
-const extern PolicyNetwork *const network;
+#ifdef DISPATCH
+namespace sse2 {
+extern const KernelSet KERNELS;
+}
+namespace avx2 {
+extern const KernelSet KERNELS;
+}
+namespace avx512 {
+extern const KernelSet KERNELS;
+}
+namespace avx512vnni {
+extern const KernelSet KERNELS;
+}
+#else
+namespace CPU_ISA {
+extern const KernelSet KERNELS;
+}
+#endif
+
+[[nodiscard]] const KernelSet &kernel_set() {
+#ifdef DISPATCH
+    static const KernelSet &selected =
+        util::cpu::select(sse2::KERNELS, avx2::KERNELS, avx512::KERNELS, avx512vnni::KERNELS);
+    return selected;
+#else
+    return CPU_ISA::KERNELS;
+#endif
+}
+
+template <typename Arch>
+const Kernels<Arch> &kernels() {
+    return std::get<Kernels<Arch>>(kernel_set());
+}
 
 namespace detail {
 
-[[nodiscard]] const util::MultiArray<i8Vec, L1_SIZE / VECTOR_SIZE> &feature(Square sq, PieceType piece,
-                                                                            Color piece_color, Color perspective,
-                                                                            Bitboard threats, Bitboard defences,
-                                                                            Square king_sq) {
-    const usize flip = (0b111000 * perspective) ^ (king_sq.file() >= File::E ? 0b000111 : 0);
-    return network
-        ->ft_weights_vec[defences.is_set(sq)][threats.is_set(sq)][piece_color != perspective][piece - 1][sq ^ flip];
+// Only valid while a network of this architecture is loaded
+template <typename Arch>
+[[nodiscard]] const Network<Arch> &network() {
+    return *static_cast<const Network<Arch> *>(active_network().weights);
 }
 
 constexpr static std::array<std::array<Bitboard, 6>, 64> DESTINATIONS = [] {
@@ -76,60 +108,166 @@ constexpr std::array<std::array<usize, 65>, 6> OFFSETS = [] {
     }
 }
 
-} // namespace detail
-
-PolicyContext::PolicyContext(const BoardState &state)
-    : stm_(state.side_to_move), king_sq_(state.king(state.side_to_move).lsb()) {
+// Brings the cached accumulator of the side to move's king bucket up to date with the given position
+template <typename Arch>
+[[nodiscard]] const Accumulator<Arch> &refresh_accumulator(const PositionFeatures &features) {
+    using Accumulator = policy::Accumulator<Arch>;
+    const auto &net = network<Arch>();
+    const auto reset = [&](Accumulator &accumulator) {
+        std::copy(net.ft_biases.begin(), net.ft_biases.end(), accumulator.values.begin());
+    };
 
-    std::array<i16Vec, L1_SIZE / VECTOR_SIZE> feature_accumulator_;
-    for (usize i = 0; i < L1_SIZE / VECTOR_SIZE; ++i) {
-        feature_accumulator_[i] = util::convert_vector<i16, i8, VECTOR_SIZE>(network->ft_biases_vec[i]);
+    thread_local AccumulatorCache<Accumulator> cache;
+    thread_local u32 cache_generation = ~0u;
+    if (cache_generation != generation()) {
+        for (auto &perspective : cache) {
+            for (auto &bucket : perspective) {
+                bucket.clear(reset);
+            }
+        }
+        cache_generation = generation();
     }
 
-    // Accumulate features for both sides, viewed from side-to-move's perspective
-    for (PieceType piece = PieceType::PAWN; piece <= PieceType::KING; piece = PieceType(piece + 1)) {
-        // Our pieces
-        const std::array<Bitboard, 2> threats = {state.threats_by(Color::WHITE), state.threats_by(Color::BLACK)};
-        for (auto sq : state.piece_bbs[piece - 1] & state.occupancy(stm_)) {
-            for (usize i = 0; i < L1_SIZE / VECTOR_SIZE; ++i) {
-                feature_accumulator_[i] += util::convert_vector<i16, i8, VECTOR_SIZE>(
-                    detail::feature(sq, piece, stm_, stm_, threats[~stm_], threats[stm_], king_sq_)[i]);
+    return cache[features.side_to_move][features.mirrored].refresh(
+        features.policy,
+        [&](Accumulator &accumulator, usize defended, usize threatened, usize enemy, usize piece, Square sq) {
+            kernels<Arch>().add_feature(
+                accumulator, net.ft_weights[defended][threatened][enemy][piece][sq ^ features.flip].data());
+        },
+        [&](Accumulator &accumulator, usize defended, usize threatened, usize enemy, usize piece, Square sq) {
+            kernels<Arch>().sub_feature(
+                accumulator, net.ft_weights[defended][threatened][enemy][piece][sq ^ features.flip].data());
+        },
+        reset);
+}
+
+template <typename Arch>
+void activate(const PositionFeatures &features, u8 *activated) {
+    kernels<Arch>().activate(refresh_accumulator<Arch>(features), activated);
+}
+
+bool packed_output = false;
+
+template <typename Arch>
+struct alignas(64) PackedOutput {
+    std::array<PackedRow<Arch>, OUTPUT_SIZE> rows;
+    // The i8 weights of each row are approximately the packed ones times its scale
+    std::array<f32, OUTPUT_SIZE> scales;
+};
+
+template <typename Arch>
+[[nodiscard]] const PackedOutput<Arch> &packed_weights() {
+    static DerivedData<PackedOutput<Arch>> derived;
+    return derived.get([](PackedOutput<Arch> &res) {
+        for (usize idx = 0; idx < OUTPUT_SIZE; ++idx) {
+            const auto &row = network<Arch>().l1_weights[idx];
+            i32 max_abs = 0;
+            for (const auto weight : row) {
+                max_abs = std::max(max_abs, std::abs(static_cast<i32>(weight)));
             }
-        }
-        // Opponent pieces
-        for (auto sq : state.piece_bbs[piece - 1] & state.occupancy(~stm_)) {
-            for (usize i = 0; i < L1_SIZE / VECTOR_SIZE; ++i) {
-                feature_accumulator_[i] += util::convert_vector<i16, i8, VECTOR_SIZE>(
-                    detail::feature(sq, piece, ~stm_, stm_, threats[~stm_], threats[stm_], king_sq_)[i]);
+            // Symmetric around zero, so the scale maps the largest weight to 7 and leaves -8 unused
+            const f32 scale = max_abs ? static_cast<f32>(max_abs) / 7.0f : 1.0f;
+            res.scales[idx] = scale;
+
+            res.rows[idx].fill(0);
+            for (usize i = 0; i < Arch::L1_SIZE / 2; ++i) {
+                const auto packed = static_cast<u8>(std::lround(static_cast<f32>(row[i]) / scale) + 8);
+                const usize block = i / (2 * PACKED_BLOCK_SIZE);
+                const usize offset = i % (2 * PACKED_BLOCK_SIZE);
+                const usize byte = block * PACKED_BLOCK_SIZE + offset % PACKED_BLOCK_SIZE;
+                res.rows[idx][byte] |= offset < PACKED_BLOCK_SIZE ? packed : static_cast<u8>(packed << 4);
             }
         }
+    });
+}
+
+// Logits of the given output indices, from whichever output weights are in use
+template <typename Arch>
+void output_logits(const u8 *activated, const usize *indices, usize count, f32 *out) {
+    const auto &net = network<Arch>();
+    std::array<i32, MAX_MOVES> dots;
+    if (packed_output) {
+        const auto &packed = packed_weights<Arch>();
+        std::array<const PackedRow<Arch> *, MAX_MOVES> rows;
+        for (usize i = 0; i < count; ++i) {
+            rows[i] = &packed.rows[indices[i]];
+        }
+        kernels<Arch>().dot_packed_rows(activated, rows.data(), count, dots.data());
+        for (usize i = 0; i < count; ++i) {
+            const i32 bias = net.l1_biases[indices[i]];
+            out[i] = (static_cast<f32>(dots[i]) * packed.scales[indices[i]] + static_cast<f32>(bias * Q)) *
+                     (1.0f / static_cast<f32>(Q * Q));
+        }
+        return;
+    }
+
+    std::array<const i8 *, MAX_MOVES> rows;
+    for (usize i = 0; i < count; ++i) {
+        rows[i] = net.l1_weights[indices[i]].data();
     }
-    for (usize i = 0; i < L1_SIZE / 2 / VECTOR_SIZE; ++i) {
-        const auto first_clamped = util::clamp_scalar<i16, VECTOR_SIZE>(feature_accumulator_[i], 0, Q);
-        const auto second_clamped =
-            util::clamp_scalar<i16, VECTOR_SIZE>(feature_accumulator_[i + L1_SIZE / 2 / VECTOR_SIZE], 0, Q);
-        activated_acc_[i] = first_clamped * second_clamped;
+    kernels<Arch>().dot_rows(activated, rows.data(), count, dots.data());
+    for (usize i = 0; i < count; ++i) {
+        const i32 bias = net.l1_biases[indices[i]];
+        out[i] = static_cast<f32>(dots[i] + bias * Q) * (1.0f / static_cast<f32>(Q * Q));
     }
 }
 
-f32 PolicyContext::logit(Move move, PieceType moving_piece) const {
-    const usize idx = detail::move_output_idx(stm_, move, moving_piece, king_sq_);
+template <typename Arch>
+void prepare() {
+    if (packed_output) {
+        (void)packed_weights<Arch>();
+    }
+}
 
-    const auto UNROLL = 4;
-    std::array<util::SimdVector<i32, VECTOR_SIZE / 2>, UNROLL> sum{};
+// Entry points for each architecture, indexed like Architectures
+struct ArchitectureFunctions {
+    void (*activate)(const PositionFeatures &features, u8 *activated);
+    void (*output_logits)(const u8 *activated, const usize *indices, usize count, f32 *out);
+    void (*prepare)();
+};
 
-    const auto &weights = network->l1_weights_vec[idx];
-    for (usize i = 0; i < L1_SIZE / 2 / VECTOR_SIZE; i += UNROLL) {
-        for (usize k = 0; k < UNROLL; ++k) {
-            const auto weights_i16 = util::convert_vector<i16, i8, VECTOR_SIZE>(weights[i + k]);
-            sum[k] += util::madd_epi16(activated_acc_[i + k], weights_i16);
-        }
-    }
+constexpr auto ARCHITECTURE_FUNCTIONS = std::apply(
+    [](auto... archs) {
+        return std::array<ArchitectureFunctions, sizeof...(archs)>{ArchitectureFunctions{
+            activate<decltype(archs)>, output_logits<decltype(archs)>, prepare<decltype(archs)>}...};
+    },
+    Architectures{});
+
+} // namespace detail
+
+void set_packed_output(bool enabled) {
+    detail::packed_output = enabled;
+    prepare();
+}
+
+void prepare() {
+    detail::ARCHITECTURE_FUNCTIONS[active_network().architecture].prepare();
+}
+
+OutputIndexer::OutputIndexer(const BoardState &state) : state_(state), king_sq_(state.king(state.side_to_move).lsb()) {}
+
+usize OutputIndexer::output_index(Move move) const {
+    return detail::move_output_idx(state_.side_to_move, move, state_.piece_type_on_sq[move.from()], king_sq_);
+}
 
-    const i32 dot = util::reduce_vector<i32, VECTOR_SIZE / 2>(std::reduce(std::begin(sum), std::end(sum)));
-    const i32 bias = network->l1_biases[idx];
+PolicyContext::PolicyContext(const BoardState &state) : PolicyContext(extract_features(state)) {}
+
+PolicyContext::PolicyContext(const PositionFeatures &features)
+    : stm_(features.side_to_move), king_sq_(features.king_sq), architecture_(active_network().architecture) {
+    detail::ARCHITECTURE_FUNCTIONS[architecture_].activate(features, activated_acc_.data());
+}
+
+f32 PolicyContext::logit(Move move, PieceType moving_piece) const {
+    const usize idx = detail::move_output_idx(stm_, move, moving_piece, king_sq_);
+    f32 res;
+    detail::ARCHITECTURE_FUNCTIONS[architecture_].output_logits(activated_acc_.data(), &idx, 1, &res);
+    return res;
+}
 
-    return static_cast<f32>(dot + bias * Q * Q) * (1.0f / static_cast<f32>(Q * Q * Q));
+void PolicyContext::logits(std::span<const usize> output_indices, std::span<f32> out) const {
+    vine_assert(out.size() >= output_indices.size());
+    detail::ARCHITECTURE_FUNCTIONS[architecture_].output_logits(activated_acc_.data(), output_indices.data(),
+                                                                output_indices.size(), out.data());
 }
 
 } // namespace network::policy
@@ -3,48 +3,76 @@
 
 #include "../chess/board_state.hpp"
 #include "../util/multi_array.hpp"
-#include "../util/simd.hpp"
+#include "features.hpp"
+#include <algorithm>
 #include <array>
 #include <span>
+#include <tuple>
 
 namespace network::policy {
 
 constexpr i16 Q = 128;
-constexpr usize L1_SIZE = 4096;
 constexpr usize OUTPUT_SIZE = 3920;
-constexpr usize VECTOR_SIZE = std::min<usize>(L1_SIZE, util::NATIVE_SIZE<i16>);
-
-using i8Vec = util::SimdVector<i8, VECTOR_SIZE>;
-using i16Vec = util::SimdVector<i16, VECTOR_SIZE>;
-
-struct alignas(util::NATIVE_VECTOR_ALIGNMENT) PolicyNetwork {
-    union {
-        util::MultiArray<i8Vec, 2, 2, 2, 6, 64, L1_SIZE / VECTOR_SIZE> ft_weights_vec;
-        util::MultiArray<i8, 2, 2, 2, 6, 64, L1_SIZE> ft_weights;
-    };
-    union {
-        std::array<i8, L1_SIZE> ft_biases;
-        std::array<i8Vec, L1_SIZE / VECTOR_SIZE> ft_biases_vec;
-    };
-    union {
-        util::MultiArray<i8Vec, OUTPUT_SIZE, L1_SIZE / 2 / VECTOR_SIZE> l1_weights_vec;
-        util::MultiArray<i8, OUTPUT_SIZE, L1_SIZE / 2> l1_weights;
-    };
+
+template <usize L1>
+struct Architecture {
+    static constexpr usize L1_SIZE = L1;
+};
+
+// Every architecture a policy network file can use, see value::Architectures. The number of outputs is fixed by the
+// move encoding, so only the feature transformer varies.
+using Architectures = std::tuple<Architecture<4096>, Architecture<1024>>;
+using DefaultArchitecture = std::tuple_element_t<0, Architectures>;
+
+// The layout is the same for every instruction set, so that one network file works with all kernels
+template <typename Arch>
+struct alignas(64) Network {
+    util::MultiArray<i8, 2, 2, 2, 6, 64, Arch::L1_SIZE> ft_weights;
+    std::array<i8, Arch::L1_SIZE> ft_biases;
+    util::MultiArray<i8, OUTPUT_SIZE, Arch::L1_SIZE / 2> l1_weights;
     std::array<i8, OUTPUT_SIZE> l1_biases;
 };
 
+constexpr usize MAX_L1_SIZE =
+    std::apply([](auto... archs) { return std::max({decltype(archs)::L1_SIZE...}); }, Architectures{});
+
+// Score moves with output weights quantised to 4 bits with a scale per row. This is lossy, but halves the memory
+// gathered for every expansion, so more of the output layer stays in cache.
+void set_packed_output(bool enabled);
+
+// Maps the moves of a position to the outputs that score them. Unlike a PolicyContext it costs next to nothing to
+// build, so moves can be indexed as they are generated, before it is known whether they will be scored at all.
+class OutputIndexer {
+  public:
+    explicit OutputIndexer(const BoardState &state);
+
+    [[nodiscard]] usize output_index(Move move) const;
+
+  private:
+    const BoardState &state_;
+    Square king_sq_;
+};
+
 class PolicyContext {
   public:
     // Build the feature accumulator for the given position (one-time per node)
     PolicyContext(const BoardState &state);
+    PolicyContext(const PositionFeatures &features);
 
     // Raw score (logit) for a specific move in the position
     [[nodiscard]] f32 logit(Move move, PieceType moving_piece) const;
+    // Raw scores of several moves at once given their output indices from an OutputIndexer, which shares the work
+    // between them. Much faster than calling logit for every move.
+    void logits(std::span<const usize> output_indices, std::span<f32> out) const;
 
   private:
     Color stm_;
     Square king_sq_;
-    std::array<util::SimdVector<i16, VECTOR_SIZE>, L1_SIZE / 2 / VECTOR_SIZE> activated_acc_{};
+    usize architecture_;
+    // Pairwise products of the clamped feature transformer outputs divided by Q, the input of the output layer. They
+    // fit in a u8, so the output layer can multiply them with its i8 weights directly. Only the first L1_SIZE / 2 of
+    // the network's architecture are used.
+    alignas(64) std::array<u8, MAX_L1_SIZE / 2> activated_acc_{};
 };
 
 } // namespace network::policy
@@ -0,0 +1,328 @@
+#include "../util/simd.hpp"
+#include "networks.hpp"
+#include "value_kernels.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <tuple>
+
+namespace network::value {
+
+// Everything in here is compiled once per instruction set in dispatch builds, so it must stay out of reach of the
+// linker: helpers have internal linkage and only the kernel table is exported, under the instruction set's namespace
+namespace CPU_ISA {
+
+namespace {
+
+constexpr usize VECTOR_SIZE = util::NATIVE_SIZE<i16>;
+
+// Only valid while a network of this architecture is loaded, which is whenever its kernels are called
+template <typename Arch>
+[[nodiscard]] const Layers<Arch> &network_layers() {
+    const auto &active = active_network();
+    return active.narrow ? static_cast<const NarrowNetwork<Arch> *>(active.weights)->layers
+                         : static_cast<const Network<Arch> *>(active.weights)->layers;
+}
+
+template <typename Arch>
+void add_feature(Accumulator<Arch> &accumulator, const i16 *weights) {
+    for (usize i = 0; i < Arch::L1_SIZE; i += VECTOR_SIZE) {
+        const auto sum = util::loadu<i16, VECTOR_SIZE>(accumulator.values.data() + i) +
+                         util::loadu<i16, VECTOR_SIZE>(weights + i);
+        util::storeu<i16, VECTOR_SIZE>(accumulator.values.data() + i, sum);
+    }
+}
+
+template <typename Arch>
+void sub_feature(Accumulator<Arch> &accumulator, const i16 *weights) {
+    for (usize i = 0; i < Arch::L1_SIZE; i += VECTOR_SIZE) {
+        const auto diff = util::loadu<i16, VECTOR_SIZE>(accumulator.values.data() + i) -
+                          util::loadu<i16, VECTOR_SIZE>(weights + i);
+        util::storeu<i16, VECTOR_SIZE>(accumulator.values.data() + i, diff);
+    }
+}
+
+template <typename Arch>
+void add_narrow_feature(Accumulator<Arch> &accumulator, const i8 *weights) {
+    for (usize i = 0; i < Arch::L1_SIZE; i += VECTOR_SIZE) {
+        const auto sum = util::loadu<i16, VECTOR_SIZE>(accumulator.values.data() + i) +
+                         util::convert_vector<i16, i8, VECTOR_SIZE>(util::loadu<i8, VECTOR_SIZE>(weights + i));
+        util::storeu<i16, VECTOR_SIZE>(accumulator.values.data() + i, sum);
+    }
+}
+
+template <typename Arch>
+void sub_narrow_feature(Accumulator<Arch> &accumulator, const i8 *weights) {
+    for (usize i = 0; i < Arch::L1_SIZE; i += VECTOR_SIZE) {
+        const auto diff = util::loadu<i16, VECTOR_SIZE>(accumulator.values.data() + i) -
+                          util::convert_vector<i16, i8, VECTOR_SIZE>(util::loadu<i8, VECTOR_SIZE>(weights + i));
+        util::storeu<i16, VECTOR_SIZE>(accumulator.values.data() + i, diff);
+    }
+}
+
+// Number of consecutive l1 activations skipped together when they are all zero. This matches the 4 u8 inputs that
+// dpbusd sums into each output lane.
+constexpr usize L1_CHUNK_SIZE = 4;
+template <typename Arch>
+constexpr usize L1_NUM_CHUNKS = Arch::L1_SIZE / 2 / L1_CHUNK_SIZE;
+
+template <typename Arch>
+using L1Activations = std::array<u16, Arch::L1_SIZE / 2>;
+template <typename Arch>
+using L2Sums = util::SimdVector<i32, Arch::L2_SIZE>;
+
+// Indices of the chunks that have a non-zero activation. This is a plain array rather than a util::StaticVector, whose
+// member functions would be shared with the copies of this file built for other instruction sets.
+template <typename Arch>
+struct L1Chunks {
+    std::array<u16, L1_NUM_CHUNKS<Arch>> indices;
+    usize size = 0;
+};
+
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+
+template <typename Arch>
+using L1WeightBlock = util::SimdVector<i8, L1_CHUNK_SIZE * Arch::L2_SIZE>;
+
+// dpbusd multiplies 4 adjacent u8 inputs with 4 adjacent i8 weights per output lane, so the l1 weights are
+// interleaved into [chunk][output][input in chunk] blocks whenever a network is loaded
+template <typename Arch>
+struct L1WeightBlocks {
+    std::array<L1WeightBlock<Arch>, L1_NUM_CHUNKS<Arch>> blocks;
+};
+
+template <typename Arch>
+[[nodiscard]] const std::array<L1WeightBlock<Arch>, L1_NUM_CHUNKS<Arch>> &l1_weight_blocks() {
+    static DerivedData<L1WeightBlocks<Arch>> derived;
+    return derived.get([](L1WeightBlocks<Arch> &res) {
+        const auto &l1_weights = network_layers<Arch>().l1_weights;
+        for (usize chunk = 0; chunk < L1_NUM_CHUNKS<Arch>; ++chunk) {
+            for (usize out = 0; out < Arch::L2_SIZE; ++out) {
+                for (usize in = 0; in < L1_CHUNK_SIZE; ++in) {
+                    res.blocks[chunk][out * L1_CHUNK_SIZE + in] = l1_weights[chunk * L1_CHUNK_SIZE + in][out];
+                }
+            }
+        }
+    }).blocks;
+}
+
+template <typename Arch>
+[[nodiscard]] L2Sums<Arch> l1_forward(const L1Activations<Arch> &activated) {
+    static_assert(sizeof(L1WeightBlock<Arch>) == 64 && sizeof(L2Sums<Arch>) == 64);
+    constexpr usize NUM_CHUNKS = L1_NUM_CHUNKS<Arch>;
+
+    // Activations go up to QA * QA, so they are split into their low and high bytes to be usable as u8 inputs.
+    // Summing both halves separately and recombining them keeps the result exact.
+    alignas(64) std::array<u32, NUM_CHUNKS> low, high;
+    u8 *low_bytes = reinterpret_cast<u8 *>(low.data());
+    u8 *high_bytes = reinterpret_cast<u8 *>(high.data());
+    for (usize i = 0; i < Arch::L1_SIZE / 2 / VECTOR_SIZE; ++i) {
+        const auto v = util::loadu<u16, VECTOR_SIZE>(activated.data() + VECTOR_SIZE * i);
+        util::storeu<u8, VECTOR_SIZE>(low_bytes + VECTOR_SIZE * i, util::convert_vector<u8, u16, VECTOR_SIZE>(v));
+        util::storeu<u8, VECTOR_SIZE>(high_bytes + VECTOR_SIZE * i, util::convert_vector<u8, u16, VECTOR_SIZE>(v >> 8));
+    }
+
+    L1Chunks<Arch> chunks;
+    for (usize chunk = 0; chunk < NUM_CHUNKS; ++chunk) {
+        chunks.indices[chunks.size] = chunk;
+        chunks.size += (low[chunk] | high[chunk]) != 0;
+    }
+
+    const auto &blocks = l1_weight_blocks<Arch>();
+    L2Sums<Arch> low_sums{}, high_sums{};
+    for (usize i = 0; i < chunks.size; ++i) {
+        const auto chunk = chunks.indices[i];
+        const auto weights = blocks[chunk];
+        low_sums = util::dpbusd_epi32(
+            low_sums, util::bit_cast<util::SimdVector<u8, 64>>(util::set1<u32, 16>(low[chunk])), weights);
+        high_sums = util::dpbusd_epi32(
+            high_sums, util::bit_cast<util::SimdVector<u8, 64>>(util::set1<u32, 16>(high[chunk])), weights);
+    }
+
+    return low_sums + high_sums * 256;
+}
+
+#else
+
+template <typename Arch>
+[[nodiscard]] L2Sums<Arch> l1_forward(const L1Activations<Arch> &activated) {
+    constexpr usize NUM_CHUNKS = L1_NUM_CHUNKS<Arch>;
+    constexpr usize L2_SIZE = Arch::L2_SIZE;
+
+    std::array<u64, NUM_CHUNKS> raw_chunks;
+    static_assert(sizeof(raw_chunks) == sizeof(activated));
+    std::memcpy(raw_chunks.data(), activated.data(), sizeof(raw_chunks));
+
+    L1Chunks<Arch> chunks;
+    for (usize chunk = 0; chunk < NUM_CHUNKS; ++chunk) {
+        chunks.indices[chunks.size] = chunk;
+        chunks.size += raw_chunks[chunk] != 0;
+    }
+
+    const auto &l1_weights = network_layers<Arch>().l1_weights;
+    L2Sums<Arch> sums{};
+    for (usize c = 0; c < chunks.size; ++c) {
+        const auto chunk = chunks.indices[c];
+        for (usize i = chunk * L1_CHUNK_SIZE; i < (chunk + 1) * L1_CHUNK_SIZE; ++i) {
+            const auto weights = util::loadu<i8, L2_SIZE>(l1_weights[i].data());
+            sums += util::set1<i32, L2_SIZE>(activated[i]) * util::convert_vector<i32, i8, L2_SIZE>(weights);
+        }
+    }
+
+    return sums;
+}
+
+#endif
+
+// Quantisation of the activated l2 and l3 values fed into the integer l2 -> l3 and l3 -> out layers
+constexpr i16 QH = 2048;
+
+// Number of l3 neurons computed by one madd of two l2 inputs
+constexpr usize L3_BLOCK_SIZE = VECTOR_SIZE / 2;
+
+// The f32 l2 and l3 weights quantised to i16 whenever a network is loaded, scaled as far as possible without the i32
+// sums of a layer overflowing. The l2 weights are stored as [input pair][output block][output][input in pair] so that
+// one madd of a broadcast input pair computes a whole output block.
+template <typename Arch>
+struct QuantisedLayers {
+    util::MultiArray<util::SimdVector<i16, VECTOR_SIZE>, Arch::L2_SIZE / 2, Arch::L3_SIZE / L3_BLOCK_SIZE> l2_weights;
+    std::array<i16, Arch::L3_SIZE> l3_weights;
+    f32 l2_dequantisation;
+    f32 l3_dequantisation;
+};
+
+[[nodiscard]] f32 weight_scale(const f32 *weights, usize size, usize num_inputs) {
+    f32 max_weight = 0;
+    for (usize i = 0; i < size; ++i) {
+        const f32 magnitude = weights[i] < 0 ? -weights[i] : weights[i];
+        max_weight = magnitude > max_weight ? magnitude : max_weight;
+    }
+    // Written without std::max and friends, whose instantiations would be shared with the other instruction sets
+    const f32 i16_limit = std::numeric_limits<i16>::max();
+    const f32 sum_limit = std::numeric_limits<i32>::max() / (num_inputs * QH);
+    const f32 limit = sum_limit < i16_limit ? sum_limit : i16_limit;
+    return max_weight > 0 ? limit / max_weight : 1;
+}
+
+template <typename Arch>
+[[nodiscard]] const QuantisedLayers<Arch> &quantised_layers() {
+    constexpr usize L2_SIZE = Arch::L2_SIZE;
+    constexpr usize L3_SIZE = Arch::L3_SIZE;
+
+    static DerivedData<QuantisedLayers<Arch>> derived;
+    return derived.get([](QuantisedLayers<Arch> &res) {
+        const auto &net = network_layers<Arch>();
+
+        const f32 l2_scale = weight_scale(net.l2_weights[0].data(), L2_SIZE * L3_SIZE, L2_SIZE);
+        for (usize in = 0; in < L2_SIZE; ++in) {
+            for (usize out = 0; out < L3_SIZE; ++out) {
+                res.l2_weights[in / 2][out / L3_BLOCK_SIZE][out % L3_BLOCK_SIZE * 2 + in % 2] =
+                    static_cast<i16>(std::lround(net.l2_weights[in][out] * l2_scale));
+            }
+        }
+        res.l2_dequantisation = 1 / (l2_scale * QH);
+
+        const f32 l3_scale = weight_scale(net.l3_weights.data(), L3_SIZE, L3_SIZE);
+        for (usize in = 0; in < L3_SIZE; ++in) {
+            res.l3_weights[in] = static_cast<i16>(std::lround(net.l3_weights[in] * l3_scale));
+        }
+        res.l3_dequantisation = 1 / (l3_scale * QH);
+    });
+}
+
+template <typename Arch>
+f32 forward(const Accumulator<Arch> &accumulator) {
+    constexpr usize L1_SIZE = Arch::L1_SIZE;
+    constexpr usize L2_SIZE = Arch::L2_SIZE;
+    constexpr usize L3_SIZE = Arch::L3_SIZE;
+    static_assert(L2_SIZE % 2 == 0 && L3_SIZE % VECTOR_SIZE == 0);
+
+    const f32 dequantisation_constant = 1.0 / (QA * QA * QB);
+    const auto &net = network_layers<Arch>();
+
+    const i16 *l1 = accumulator.values.data();
+
+    alignas(util::NATIVE_VECTOR_ALIGNMENT) L1Activations<Arch> activated;
+    for (usize i = 0; i < L1_SIZE / 2 / VECTOR_SIZE; ++i) {
+        // Load register values for pairwise
+        auto left = util::loadu<i16, VECTOR_SIZE>(l1 + VECTOR_SIZE * i);
+        auto right = util::loadu<i16, VECTOR_SIZE>(l1 + VECTOR_SIZE * i + L1_SIZE / 2);
+
+        // Clamp to [0, 1] (quantized)
+        left = util::clamp_scalar<i16, VECTOR_SIZE>(left, 0, QA);
+        right = util::clamp_scalar<i16, VECTOR_SIZE>(right, 0, QA);
+
+        // Widen so pairwise doesnt overflow the i16s, using u16s here is neutral
+        const auto left_widened = util::convert_vector<u16, i16, VECTOR_SIZE>(left);
+        const auto right_widened = util::convert_vector<u16, i16, VECTOR_SIZE>(right);
+
+        // Pairwise multiply the clamped values
+        util::storeu<u16, VECTOR_SIZE>(activated.data() + VECTOR_SIZE * i, left_widened * right_widened);
+    }
+
+    // Matrix multiply l1 -> l2, skipping the weights of inputs that were clipped to zero
+    const auto l2_int = l1_forward<Arch>(activated);
+
+    // Dequantise and activate l2, then requantise it for the integer layers
+    auto l2 = util::fma<f32, L2_SIZE>(util::convert_vector<f32, i32, L2_SIZE>(l2_int),
+                                      util::set1<f32, L2_SIZE>(dequantisation_constant),
+                                      util::loadu<f32, L2_SIZE>(net.l1_biases.data()));
+    l2 = util::clamp_scalar<f32, L2_SIZE>(l2, 0, 1);
+    l2 *= l2;
+    const auto l2_pairs = util::bit_cast<std::array<i32, L2_SIZE / 2>>(
+        util::convert_vector<i16, f32, L2_SIZE>(l2 * util::set1<f32, L2_SIZE>(QH) + util::set1<f32, L2_SIZE>(0.5f)));
+
+    const auto &layers = quantised_layers<Arch>();
+
+    alignas(util::NATIVE_VECTOR_ALIGNMENT) std::array<i16, L3_SIZE> l3;
+    for (usize block = 0; block < L3_SIZE / L3_BLOCK_SIZE; ++block) {
+        // Matrix multiply l2 -> l3, two inputs at a time
+        util::SimdVector<i32, L3_BLOCK_SIZE> sums{};
+        for (usize pair = 0; pair < L2_SIZE / 2; ++pair) {
+            const auto inputs =
+                util::bit_cast<util::SimdVector<i16, VECTOR_SIZE>>(util::set1<i32, L3_BLOCK_SIZE>(l2_pairs[pair]));
+            sums += util::madd_epi16(inputs, layers.l2_weights[pair][block]);
+        }
+
+        // Dequantise and activate l3, then requantise it for l3 -> out
+        const auto biases = util::loadu<f32, L3_BLOCK_SIZE>(net.l2_biases.data() + L3_BLOCK_SIZE * block);
+        auto v = util::fma<f32, L3_BLOCK_SIZE>(util::convert_vector<f32, i32, L3_BLOCK_SIZE>(sums),
+                                               util::set1<f32, L3_BLOCK_SIZE>(layers.l2_dequantisation), biases);
+        v = util::clamp_scalar<f32, L3_BLOCK_SIZE>(v, 0, 1);
+        v *= v;
+        const auto requantised = v * util::set1<f32, L3_BLOCK_SIZE>(QH) + util::set1<f32, L3_BLOCK_SIZE>(0.5f);
+        util::storeu<i16, L3_BLOCK_SIZE>(l3.data() + L3_BLOCK_SIZE * block,
+                                         util::convert_vector<i16, f32, L3_BLOCK_SIZE>(requantised));
+    }
+
+    // Matrix multiply l3 -> out
+    util::SimdVector<i32, VECTOR_SIZE / 2> out{};
+    for (usize i = 0; i < L3_SIZE; i += VECTOR_SIZE) {
+        out += util::madd_epi16(util::loadu<i16, VECTOR_SIZE>(l3.data() + i),
+                                util::loadu<i16, VECTOR_SIZE>(layers.l3_weights.data() + i));
+    }
+
+    return util::reduce_vector<i32, VECTOR_SIZE / 2>(out) * layers.l3_dequantisation + net.l3_biases[0];
+}
+
+template <typename Arch>
+void prepare() {
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+    (void)l1_weight_blocks<Arch>();
+#endif
+    (void)quantised_layers<Arch>();
+}
+
+template <typename Arch>
+constexpr Kernels<Arch> KERNELS_OF = {add_feature<Arch>,        sub_feature<Arch>, add_narrow_feature<Arch>,
+                                      sub_narrow_feature<Arch>, forward<Arch>,     prepare<Arch>};
+
+} // namespace
+
+extern const KernelSet KERNELS = std::apply([](auto... archs) { return KernelSet{KERNELS_OF<decltype(archs)>...}; },
+                                            Architectures{});
+
+} // namespace CPU_ISA
+
+} // namespace network::value
@@ -0,0 +1,55 @@
+#ifndef VALUE_KERNELS_HPP
+#define VALUE_KERNELS_HPP
+
+#include "value_network.hpp"
+
+#include <array>
+
+namespace network::value {
+
+// The loaded network, a Network<Arch> or a NarrowNetwork<Arch> of the architecture at the given index of Architectures
+struct ActiveNetwork {
+    const void *weights;
+    usize architecture;
+    bool narrow;
+};
+
+// Starts out as the embedded network. It lives in a function local static, since the uci options load networks while
+// globals are still being initialised.
+[[nodiscard]] ActiveNetwork &active_network();
+
+template <typename Arch>
+struct alignas(64) Accumulator {
+    std::array<i16, Arch::L1_SIZE> values;
+};
+
+// The instruction set specific parts of the value network. Dispatch builds compile value_kernels.cpp once per
+// instruction set and pick one set of kernels at startup.
+template <typename Arch>
+struct Kernels {
+    // Adds or subtracts one row of feature transformer weights
+    void (*add_feature)(Accumulator<Arch> &accumulator, const i16 *weights);
+    void (*sub_feature)(Accumulator<Arch> &accumulator, const i16 *weights);
+    // The same for rows narrowed to i8, which are widened on the fly
+    void (*add_narrow_feature)(Accumulator<Arch> &accumulator, const i8 *weights);
+    void (*sub_narrow_feature)(Accumulator<Arch> &accumulator, const i8 *weights);
+    // Runs every layer after the feature transformer, returning the raw network output
+    f32 (*forward)(const Accumulator<Arch> &accumulator);
+    // Rearranges the weights of a newly loaded network into the layouts forward uses
+    void (*prepare)();
+};
+
+// The kernels of every architecture, in the order of Architectures
+template <typename... Archs>
+std::tuple<Kernels<Archs>...> kernel_set_of(std::tuple<Archs...>);
+using KernelSet = decltype(kernel_set_of(Architectures{}));
+
+template <typename Arch>
+[[nodiscard]] const Kernels<Arch> &kernels();
+
+// Builds everything derived from a newly loaded value network
+void prepare();
+
+} // namespace network::value
+
+#endif // VALUE_KERNELS_HPP
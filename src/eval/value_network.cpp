@@ -1,124 +1,147 @@
 #include "value_network.hpp"
+#include "../util/cpu.hpp"
+#include "accumulator_cache.hpp"
+#include "networks.hpp"
+#include "value_kernels.hpp"
 
-#include <algorithm>
 #include <array>
 #include <cstring>
 
 namespace network::value {
 
-const extern ValueNetwork *const network;
+#ifdef DISPATCH
+namespace sse2 {
+extern const KernelSet KERNELS;
+}
+namespace avx2 {
+extern const KernelSet KERNELS;
+}
+namespace avx512 {
+extern const KernelSet KERNELS;
+}
+namespace avx512vnni {
+extern const KernelSet KERNELS;
+}
+#else
+namespace CPU_ISA {
+extern const KernelSet KERNELS;
+}
+#endif
+
+[[nodiscard]] const KernelSet &kernel_set() {
+#ifdef DISPATCH
+    static const KernelSet &selected =
+        util::cpu::select(sse2::KERNELS, avx2::KERNELS, avx512::KERNELS, avx512vnni::KERNELS);
+    return selected;
+#else
+    return CPU_ISA::KERNELS;
+#endif
+}
+
+template <typename Arch>
+const Kernels<Arch> &kernels() {
+    return std::get<Kernels<Arch>>(kernel_set());
+}
 
 namespace detail {
 
-[[nodiscard]] const util::MultiArray<i16Vec, L1_SIZE / VECTOR_SIZE> &feature(Square sq, PieceType piece,
-                                                                             Color piece_color, Color perspective,
-                                                                             Square king_sq, Bitboard threats,
-                                                                             Bitboard defences) {
-    usize flip = 0b111000 * perspective ^ 0b000111 * (king_sq.file() >= File::E);
-    return network
-        ->ft_weights_vec[defences.is_set(sq)][threats.is_set(sq)][piece_color != perspective][piece - 1][sq ^ flip];
+// Only valid while a network of this architecture is loaded
+template <typename Arch>
+[[nodiscard]] const Network<Arch> &network() {
+    return *static_cast<const Network<Arch> *>(active_network().weights);
 }
 
-} // namespace detail
-
-f64 evaluate(const BoardState &state) {
-    std::array<i16Vec, L1_SIZE / VECTOR_SIZE> accumulator;
-    std::memcpy(accumulator.data(), network->ft_biases.data(), sizeof(accumulator));
-
-    const auto stm = state.side_to_move;
-    const auto king_sq = state.king(stm).lsb();
-
-    const std::array<Bitboard, 2> threats = {state.pinned_threats_by(Color::WHITE),
-                                             state.pinned_threats_by(Color::BLACK)};
-
-    // Accumulate features for both sides, viewed from side-to-move's perspective
-    for (PieceType piece = PieceType::PAWN; piece <= PieceType::KING; piece = PieceType(piece + 1)) {
-        // Our pieces
-        for (auto sq : state.piece_bbs[piece - 1] & state.occupancy(stm)) {
-            const auto feat = detail::feature(sq, piece, stm, stm, king_sq, threats[~stm], threats[stm]);
-            for (usize i = 0; i < L1_SIZE / VECTOR_SIZE; ++i) {
-                accumulator[i] += feat[i];
-            }
-        }
+// Only valid while a network of this architecture with narrowed feature transformer weights is loaded
+template <typename Arch>
+[[nodiscard]] const NarrowNetwork<Arch> &narrow_network() {
+    return *static_cast<const NarrowNetwork<Arch> *>(active_network().weights);
+}
 
-        // Opponent pieces
-        for (auto sq : state.piece_bbs[piece - 1] & state.occupancy(~stm)) {
-            const auto feat = detail::feature(sq, piece, ~stm, stm, king_sq, threats[stm], threats[~stm]);
-            for (usize i = 0; i < L1_SIZE / VECTOR_SIZE; ++i) {
-                accumulator[i] += feat[i];
+// Brings the cached accumulator of the side to move's king bucket up to date with the given position
+template <typename Arch>
+[[nodiscard]] const Accumulator<Arch> &refresh_accumulator(const PositionFeatures &features) {
+    using Accumulator = value::Accumulator<Arch>;
+    const auto &ft_biases =
+        active_network().narrow ? narrow_network<Arch>().layers.ft_biases : network<Arch>().layers.ft_biases;
+    const auto reset = [&](Accumulator &accumulator) {
+        std::memcpy(accumulator.values.data(), ft_biases.data(), sizeof(accumulator));
+    };
+
+    thread_local AccumulatorCache<Accumulator> cache;
+    thread_local u32 cache_generation = ~0u;
+    if (cache_generation != generation()) {
+        for (auto &perspective : cache) {
+            for (auto &bucket : perspective) {
+                bucket.clear(reset);
             }
         }
+        cache_generation = generation();
     }
 
-    const f32 dequantisation_constant = 1.0 / (QA * QA * QB);
-
-    const i16 *l1 = reinterpret_cast<const i16 *>(accumulator.data());
-
-    std::array<i32, L2_SIZE> l2_int{};
-    for (usize i = 0; i < L1_SIZE / 2 / L2_REG_SIZE; ++i) {
-        // Load register values for pairwise
-        auto left = util::loadu<i16, L2_REG_SIZE>(l1 + L2_REG_SIZE * i);
-        auto right = util::loadu<i16, L2_REG_SIZE>(l1 + L2_REG_SIZE * i + L1_SIZE / 2);
-
-        // Clamp to [0, 1] (quantized)
-        left = util::clamp_scalar<i16, L2_REG_SIZE>(left, 0, QA);
-        right = util::clamp_scalar<i16, L2_REG_SIZE>(right, 0, QA);
-
-        // Widen so pairwise doesnt overflow the i16s, using u16s here is neutral
-        const auto left_widened = util::convert_vector<u16, i16, L2_REG_SIZE>(left);
-        const auto right_widened = util::convert_vector<u16, i16, L2_REG_SIZE>(right);
-
-        // Pairwise multiply the clamped values
-        const auto activated = left_widened * right_widened;
-
-        //  Matrix multiply l1 -> l2
-        for (usize j = 0; j < L2_REG_SIZE; ++j) {
-            const auto idx = i * L2_REG_SIZE + j;
-            for (usize k = 0; k < L2_SIZE; ++k) {
-                l2_int[k] += activated[j] * network->l1_weights[idx][k];
-            }
-        }
+    auto &bucket = cache[features.side_to_move][features.mirrored];
+    if (active_network().narrow) {
+        const auto &ft_weights = narrow_network<Arch>().ft_weights;
+        return bucket.refresh(
+            features.value,
+            [&](Accumulator &accumulator, usize defended, usize threatened, usize enemy, usize piece, Square sq) {
+                kernels<Arch>().add_narrow_feature(
+                    accumulator, ft_weights[defended][threatened][enemy][piece][sq ^ features.flip].data());
+            },
+            [&](Accumulator &accumulator, usize defended, usize threatened, usize enemy, usize piece, Square sq) {
+                kernels<Arch>().sub_narrow_feature(
+                    accumulator, ft_weights[defended][threatened][enemy][piece][sq ^ features.flip].data());
+            },
+            reset);
     }
+    const auto &ft_weights = network<Arch>().ft_weights;
+    return bucket.refresh(
+        features.value,
+        [&](Accumulator &accumulator, usize defended, usize threatened, usize enemy, usize piece, Square sq) {
+            kernels<Arch>().add_feature(
+                accumulator, ft_weights[defended][threatened][enemy][piece][sq ^ features.flip].data());
+        },
+        [&](Accumulator &accumulator, usize defended, usize threatened, usize enemy, usize piece, Square sq) {
+            kernels<Arch>().sub_feature(
+                accumulator, ft_weights[defended][threatened][enemy][piece][sq ^ features.flip].data());
+        },
+        reset);
+}
 
-    std::array<f32, L2_SIZE> l2;
-    for (usize i = 0; i < L2_SIZE; ++i) {
-        l2[i] = l2_int[i] * dequantisation_constant + network->l1_biases[i];
-    }
+template <typename Arch>
+[[nodiscard]] f64 evaluate(const PositionFeatures &features) {
+    return kernels<Arch>().forward(refresh_accumulator<Arch>(features));
+}
 
-    // Activate l2
-    for (usize i = 0; i < L2_SIZE / L2_REG_SIZE; ++i) {
-        auto v = util::loadu<f32, L2_REG_SIZE>(l2.data() + L2_REG_SIZE * i);
-        v = util::clamp_scalar<f32, L2_REG_SIZE>(v, 0, 1);
-        v *= v;
-        util::storeu<f32, L2_REG_SIZE>(l2.data() + L2_REG_SIZE * i, v);
-    }
+template <typename Arch>
+void prepare() {
+    kernels<Arch>().prepare();
+}
 
-    std::array<f32, L3_SIZE> l3{};
-    for (usize i = 0; i < L3_SIZE / L3_REG_SIZE; ++i) {
-        auto v = util::loadu<f32, L3_REG_SIZE>(network->l2_biases.data() + L3_REG_SIZE * i);
+// Entry points for each architecture, indexed like Architectures
+struct ArchitectureFunctions {
+    f64 (*evaluate)(const PositionFeatures &features);
+    void (*prepare)();
+};
 
-        // Matrix multiply l2 -> l3
-        for (usize j = 0; j < L2_SIZE; ++j) {
-            const auto l2_val = util::set1<f32, L3_REG_SIZE>(l2[j]);
-            const auto w = network->l2_weights_vec[j][i];
-            v = util::fma<f32, L3_REG_SIZE>(l2_val, w, v);
-        }
+constexpr auto ARCHITECTURE_FUNCTIONS = std::apply(
+    [](auto... archs) {
+        return std::array<ArchitectureFunctions, sizeof...(archs)>{
+            ArchitectureFunctions{evaluate<decltype(archs)>, prepare<decltype(archs)>}...};
+    },
+    Architectures{});
 
-        // Activate l3
-        v = util::clamp_scalar<f32, L3_REG_SIZE>(v, 0, 1);
-        v *= v;
+} // namespace detail
 
-        // Matrix multiply l3 -> out
-        const auto l3_val = util::loadu<f32, L3_REG_SIZE>(l3.data() + L3_REG_SIZE * i);
-        util::storeu<f32, L3_REG_SIZE>(l3.data() + L3_REG_SIZE * i,
-                                       util::fma<f32, L3_REG_SIZE>(v, network->l3_weights_vec[i], l3_val));
-    }
+f64 evaluate(const PositionFeatures &features) {
+    return detail::ARCHITECTURE_FUNCTIONS[active_network().architecture].evaluate(features);
+}
 
-    f32 final_sum = network->l3_biases[0];
-    for (usize i = 0; i < L3_SIZE; ++i) {
-        final_sum += l3[i];
-    }
-    return final_sum;
+f64 evaluate(const BoardState &state) {
+    return evaluate(extract_features(state));
+}
+
+void prepare() {
+    detail::ARCHITECTURE_FUNCTIONS[active_network().architecture].prepare();
 }
 
 } // namespace network::value
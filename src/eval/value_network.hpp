@@ -3,52 +3,61 @@
 
 #include "../chess/board_state.hpp"
 #include "../util/multi_array.hpp"
-#include "../util/simd.hpp"
-#include <algorithm>
+#include "features.hpp"
+
+#include <tuple>
 
 namespace network::value {
 
 constexpr i16 QA = 255;
 constexpr i16 QB = 64;
-constexpr usize L1_SIZE = 4096;
-constexpr usize L2_SIZE = 16;
-constexpr usize L3_SIZE = 128;
-constexpr usize VECTOR_SIZE = util::NATIVE_SIZE<i16>;
-constexpr usize L2_REG_SIZE = std::min(util::NATIVE_SIZE<i16>, L2_SIZE);
-constexpr usize L3_REG_SIZE = std::min(util::NATIVE_SIZE<f32>, L3_SIZE);
 
 constexpr i16 EVAL_SCALE = 400;
 
-using i16Vec = util::SimdVector<i16, VECTOR_SIZE>;
-using i8Vec = util::SimdVector<i8, VECTOR_SIZE>;
-
-struct alignas(util::NATIVE_VECTOR_ALIGNMENT) ValueNetwork {
-    union {
-        util::MultiArray<i16Vec, 2, 2, 2, 6, 64, L1_SIZE / VECTOR_SIZE> ft_weights_vec;
-        util::MultiArray<i16, 2, 2, 2, 6, 64, L1_SIZE> ft_weights;
-    };
-    util::MultiArray<i16, L1_SIZE> ft_biases;
-
-    union {
-        util::MultiArray<util::SimdVector<i8, L2_REG_SIZE>, L1_SIZE / 2, L2_SIZE / L2_REG_SIZE> l1_weights_vec;
-        util::MultiArray<i8, L1_SIZE / 2, L2_SIZE> l1_weights;
-    };
-    util::MultiArray<f32, L2_SIZE> l1_biases;
-
-    union {
-        util::MultiArray<util::SimdVector<f32, L3_REG_SIZE>, L2_SIZE, L3_SIZE / L3_REG_SIZE> l2_weights_vec;
-        util::MultiArray<f32, L2_SIZE, L3_SIZE> l2_weights;
-    };
-    util::MultiArray<f32, L3_SIZE> l2_biases;
-
-    union {
-        util::MultiArray<util::SimdVector<f32, L3_REG_SIZE>, L3_SIZE / L3_REG_SIZE> l3_weights_vec;
-        util::MultiArray<f32, L3_SIZE> l3_weights;
-    };
+template <usize L1, usize L2, usize L3>
+struct Architecture {
+    static constexpr usize L1_SIZE = L1;
+    static constexpr usize L2_SIZE = L2;
+    static constexpr usize L3_SIZE = L3;
+};
+
+// Every architecture a value network file can use, picked by its header when it is loaded. The evaluation code is
+// compiled once for each of them, so keep the list short. The first one is the architecture of the embedded network.
+using Architectures = std::tuple<Architecture<4096, 16, 128>, Architecture<1024, 16, 32>>;
+using DefaultArchitecture = std::tuple_element_t<0, Architectures>;
+
+// Everything after the feature transformer weights, laid out the same however those are stored
+template <typename Arch>
+struct Layers {
+    util::MultiArray<i16, Arch::L1_SIZE> ft_biases;
+
+    util::MultiArray<i8, Arch::L1_SIZE / 2, Arch::L2_SIZE> l1_weights;
+    util::MultiArray<f32, Arch::L2_SIZE> l1_biases;
+
+    util::MultiArray<f32, Arch::L2_SIZE, Arch::L3_SIZE> l2_weights;
+    util::MultiArray<f32, Arch::L3_SIZE> l2_biases;
+
+    util::MultiArray<f32, Arch::L3_SIZE> l3_weights;
     util::MultiArray<f32, 1> l3_biases;
 };
 
+// The layout is the same for every instruction set, so that one network file works with all kernels
+template <typename Arch>
+struct alignas(64) Network {
+    util::MultiArray<i16, 2, 2, 2, 6, 64, Arch::L1_SIZE> ft_weights;
+    Layers<Arch> layers;
+};
+
+// A network whose feature transformer weights all fit in i8, which tools/concat_networks.py stores narrowed and marks
+// in the header. Refreshing an accumulator from it streams through half the memory.
+template <typename Arch>
+struct alignas(64) NarrowNetwork {
+    util::MultiArray<i8, 2, 2, 2, 6, 64, Arch::L1_SIZE> ft_weights;
+    Layers<Arch> layers;
+};
+
 f64 evaluate(const BoardState &state);
+f64 evaluate(const PositionFeatures &features);
 
 } // namespace network::value
 
@@ -0,0 +1,45 @@
+#include "feature_cache.hpp"
+#include <algorithm>
+
+namespace search {
+
+void FeatureCache::set_entry_capacity(usize capacity) {
+    table_.clear();
+    table_.shrink_to_fit();
+    table_.resize(capacity);
+}
+
+void FeatureCache::clear() {
+    std::ranges::fill(table_, FeatureCacheEntry{});
+    stats_ = {};
+}
+
+const network::PositionFeatures *FeatureCache::probe(HashKey hash_key) {
+    ++stats_.probes;
+    if (table_.empty()) {
+        return nullptr;
+    }
+    const auto &entry = table_[index(hash_key)];
+    if (entry.hash_key != hash_key) {
+        return nullptr;
+    }
+    ++stats_.hits;
+    return &entry.features;
+}
+
+void FeatureCache::store(HashKey hash_key, const network::PositionFeatures &features) {
+    if (table_.empty()) {
+        return;
+    }
+    table_[index(hash_key)] = {hash_key, features};
+}
+
+const FeatureCacheStats &FeatureCache::stats() const {
+    return stats_;
+}
+
+usize FeatureCache::index(HashKey hash_key) const {
+    return hash_key % table_.size();
+}
+
+} // namespace search
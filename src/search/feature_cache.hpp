@@ -0,0 +1,46 @@
+#ifndef FEATURE_CACHE_HPP
+#define FEATURE_CACHE_HPP
+
+#include "../chess/zobrist.hpp"
+#include "../eval/features.hpp"
+#include "../util/types.hpp"
+
+#include <vector>
+
+namespace search {
+
+struct FeatureCacheEntry {
+    HashKey hash_key = 0;
+    network::PositionFeatures features;
+};
+
+struct FeatureCacheStats {
+    u64 probes = 0;
+    u64 hits = 0;
+};
+
+// Keeps the features a leaf was simulated with, so that expanding it on its next visit hands them to the policy
+// network instead of extracting them from the position a second time. Leaves are usually revisited soon after their
+// first visit, so a small direct mapped table catches most of them.
+class FeatureCache {
+  public:
+    void set_entry_capacity(usize capacity);
+
+    void clear();
+
+    [[nodiscard]] const network::PositionFeatures *probe(HashKey hash_key);
+
+    void store(HashKey hash_key, const network::PositionFeatures &features);
+
+    [[nodiscard]] const FeatureCacheStats &stats() const;
+
+  private:
+    [[nodiscard]] usize index(HashKey hash_key) const;
+
+    std::vector<FeatureCacheEntry> table_;
+    FeatureCacheStats stats_;
+};
+
+} // namespace search
+
+#endif // FEATURE_CACHE_HPP
@@ -9,6 +9,7 @@
 #include "node.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <limits>
 
@@ -33,6 +34,41 @@ TUNABLE_STEP(BISHOP_MATERIAL, 315, 100, 600, 30);
 TUNABLE_STEP(ROOK_MATERIAL, 473, 300, 800, 40);
 TUNABLE_STEP(QUEEN_MATERIAL, 863, 500, 1500, 50);
 
+namespace {
+
+// Move generation sink that writes moves straight into the child nodes of a node being expanded, and the policy output
+// index of every move alongside them
+class ChildSink {
+  public:
+    ChildSink(Node *children, const network::policy::OutputIndexer &indexer) : children_(children), indexer_(indexer) {}
+
+    void push_back(Move move) {
+        push_back_conditional(move, true);
+    }
+
+    void push_back_conditional(Move move, bool condition) {
+        children_[size_] = Node{.move = move};
+        output_indices_[size_] = indexer_.output_index(move);
+        size_ += condition;
+    }
+
+    [[nodiscard]] usize size() const {
+        return size_;
+    }
+
+    [[nodiscard]] std::span<const usize> output_indices() const {
+        return {output_indices_.data(), size_};
+    }
+
+  private:
+    Node *children_;
+    const network::policy::OutputIndexer &indexer_;
+    std::array<usize, MAX_MOVES> output_indices_;
+    usize size_ = 0;
+};
+
+} // namespace
+
 GameTree::GameTree()
     : halves_({TreeHalf(TreeHalf::Index::LOWER), TreeHalf(TreeHalf::Index::UPPER)}),
       active_half_(TreeHalf::Index::LOWER) {
@@ -49,6 +85,10 @@ void GameTree::set_hash_table_capacity(usize capacity) {
     hash_table_.set_entry_capacity(capacity);
 }
 
+void GameTree::set_feature_cache_capacity(usize capacity) {
+    feature_cache_.set_entry_capacity(capacity);
+}
+
 void GameTree::new_search(const Board &root_board) {
     if (advance_root_node(board_, root_board, active_half().root_idx())) {
         // Re-compute root policy scores, since the node we advanced to was searched with non-root parameters
@@ -93,6 +133,10 @@ u64 GameTree::tree_usage() const {
     return tree_usage_;
 }
 
+const FeatureCache &GameTree::feature_cache() const {
+    return feature_cache_;
+}
+
 NodeIndex GameTree::select_and_expand_node() {
     // Lambda to compute the PUCT score for a given child node in MCTS
     // Arguments:
@@ -180,39 +224,55 @@ NodeIndex GameTree::select_and_expand_node() {
 }
 
 void GameTree::compute_policy(const BoardState &state, NodeIndex node_idx) {
-    Node &node = node_at(node_idx);
+    const network::policy::OutputIndexer indexer(state);
+    std::array<usize, MAX_MOVES> output_indices;
+    const auto children = get_children(node_at(node_idx));
+    for (usize i = 0; i < children.size(); ++i) {
+        output_indices[i] = indexer.output_index(children[i].move);
+    }
+    compute_policy(state, {output_indices.data(), children.size()}, node_idx);
+}
 
-    // We keep track of a policy context so that we only accumulate once per node
-    const network::policy::PolicyContext ctx(state);
+void GameTree::compute_policy(const BoardState &state, std::span<const usize> output_indices, NodeIndex node_idx) {
+    // We keep track of a policy context so that we only accumulate once per node. It is built from the features the
+    // node was simulated with when they are still cached.
+    const auto *cached_features = feature_cache_.probe(state.hash_key);
+    const network::policy::PolicyContext ctx =
+        cached_features ? network::policy::PolicyContext(*cached_features) : network::policy::PolicyContext(state);
+
+    Node &node = node_at(node_idx);
+    const auto children = get_children(node);
 
     const bool root_node = node_idx == active_half().root_idx();
     const f32 temperature = root_node ? ROOT_SOFTMAX_TEMPERATURE : SOFTMAX_TEMPERATURE;
 
+    // Score all moves in one batch, and keep the scores in a contiguous array for the passes below
+    std::array<f32, MAX_MOVES> scores;
+    ctx.logits(output_indices, scores);
+
     f32 highest_policy = -std::numeric_limits<f32>::max();
-    for (Node &child : get_children(node)) {
-        // Compute policy output for this move
+    for (usize i = 0; i < children.size(); ++i) {
         const auto history_score =
-            history_.entry(board_.state(), child.move).value / static_cast<f64>(POLICY_HISTORY_DIVISOR);
-        child.policy_score =
-            (ctx.logit(child.move, state.get_piece_type(child.move.from())) + history_score) / temperature;
+            history_.entry(board_.state(), children[i].move).value / static_cast<f64>(POLICY_HISTORY_DIVISOR);
+        scores[i] = (scores[i] + history_score) / temperature;
         // Keep track of highest policy so we can shift all the policy
         // values down to avoid precision loss from large exponents
-        highest_policy = std::max(highest_policy, child.policy_score);
+        highest_policy = std::max(highest_policy, scores[i]);
     }
 
     // Softmax the policy logits
     f32 sum_exponents = 0.0f;
-    for (Node &child : get_children(node)) {
-        const f32 exp_policy = std::exp(child.policy_score - highest_policy);
-        sum_exponents += exp_policy;
-        child.policy_score = exp_policy;
+    for (usize i = 0; i < children.size(); ++i) {
+        scores[i] = std::exp(scores[i] - highest_policy);
+        sum_exponents += scores[i];
     }
 
     f32 sum_squares = 0.0f;
     // Normalize into policy scores
-    for (Node &child : get_children(node)) {
-        child.policy_score /= sum_exponents;
-        sum_squares += child.policy_score * child.policy_score;
+    for (usize i = 0; i < children.size(); ++i) {
+        scores[i] /= sum_exponents;
+        sum_squares += scores[i] * scores[i];
+        children[i].policy_score = scores[i];
     }
 
     node.gini_impurity = static_cast<u8>(255.0f * std::clamp(1.0f - sum_squares, 0.0f, 1.0f));
@@ -233,33 +293,31 @@ bool GameTree::expand_node(NodeIndex node_idx) {
         return true;
     }
 
-    MoveList move_list;
-    generate_moves(board_.state(), move_list);
+    // Generate the children straight into the free space of the tree, which only becomes theirs once there is room,
+    // along with their policy output indices. The far more expensive policy context waits until the node is known to
+    // need one.
+    const network::policy::OutputIndexer indexer(board_.state());
+    ChildSink children(active_half().unfilled_nodes(), indexer);
+    generate_moves(board_.state(), children);
 
-    if (move_list.empty()) {
+    if (children.size() == 0) {
         node.terminal_state = board_.state().checkers != 0 ? TerminalState::loss(0) : TerminalState::draw();
         return true;
     }
 
     // Return early if we will run out of tree capacity
-    if (!active_half().has_room_for(move_list.size())) {
+    if (!active_half().has_room_for(children.size())) {
         return false;
     }
 
     node.first_child_idx = active_half().construct_idx(active_half().filled_size());
-    node.num_children = move_list.size();
-
-    // Append all child nodes to the nodes with the move that leads to it
-    for (const auto move : move_list) {
-        active_half().push_node(Node{
-            .move = move,
-        });
-    }
+    node.num_children = children.size();
+    active_half().fill_nodes(children.size());
 
     tree_usage_ += node.num_children * sizeof(Node);
 
     // Compute and store policy values for all the child nodes
-    compute_policy(board_.state(), node_idx);
+    compute_policy(board_.state(), children.output_indices(), node_idx);
 
     return true;
 }
@@ -281,7 +339,10 @@ f64 GameTree::simulate_node(NodeIndex node_idx) {
     const auto num_queens = board_.state().queens().pop_count();
     const auto sum_material = KNIGHT_MATERIAL * num_knights + BISHOP_MATERIAL * num_bishops +
                               ROOK_MATERIAL * num_rooks + QUEEN_MATERIAL * num_queens;
-    const auto raw_eval = network::value::evaluate(board_.state());
+    // Keep the features for the policy network, which reads the same ones once this node gets expanded
+    const auto features = network::extract_features(board_.state());
+    const auto raw_eval = network::value::evaluate(features);
+    feature_cache_.store(board_.state().hash_key, features);
     const auto scaled = raw_eval * (sum_material + 8192) / 16384;
 
     return util::math::sigmoid(scaled);
@@ -438,6 +499,7 @@ void GameTree::clear() {
         half.clear();
     }
     hash_table_.clear();
+    feature_cache_.clear();
     tree_usage_ = 0;
     active_half_ = {};
     board_ = {};
@@ -2,6 +2,8 @@
 #define GAME_TREE_HPP
 
 #include "../chess/board.hpp"
+#include "../eval/policy_network.hpp"
+#include "feature_cache.hpp"
 #include "hash_table.hpp"
 #include "history.hpp"
 #include "node.hpp"
@@ -17,6 +19,7 @@ class GameTree {
 
     void set_node_capacity(usize capacity);
     void set_hash_table_capacity(usize capacity);
+    void set_feature_cache_capacity(usize capacity);
 
     void new_search(const Board &root_board);
 
@@ -27,6 +30,7 @@ class GameTree {
 
     [[nodiscard]] u32 sum_depths() const;
     [[nodiscard]] u64 tree_usage() const;
+    [[nodiscard]] const FeatureCache &feature_cache() const;
 
     // Stage 1/2: Selection & Expansion
     // Selection is the first stage of an iteration and finds a leaf node for us to expand and/or simulate.
@@ -36,6 +40,8 @@ class GameTree {
     // This function computes the policy scores for all children of a node that is already expanded. The policy score is
     // the main influence of the PUCT algorithm, which drives the selection stage toward a new leaf node to expand.
     void compute_policy(const BoardState &state, NodeIndex node_idx);
+    // The same with the policy output indices of the children already at hand
+    void compute_policy(const BoardState &state, std::span<const usize> output_indices, NodeIndex node_idx);
 
     // Stage 3: Simulation
     // Calls out to the value head to return a score for the node that is being simulated.
@@ -66,6 +72,7 @@ class GameTree {
 
     std::array<TreeHalf, 2> halves_;
     HashTable hash_table_;
+    FeatureCache feature_cache_;
     u64 tree_usage_ = 0;
     TreeHalf::Index active_half_;
     Board board_;
@@ -7,6 +7,7 @@ namespace search {
 
 Searcher::Searcher() : verbosity_(Verbosity::VERBOSE) {
     set_thread_count(1);
+    set_feature_cache_size(DEFAULT_FEATURE_CACHE_SIZE);
 }
 
 void Searcher::set_thread_count(u16 thread_count) {
@@ -21,6 +22,11 @@ void Searcher::set_hash_size(u32 size_in_mb) {
     game_tree_.set_hash_table_capacity(hash_table_capacity / sizeof(HashEntry));
 }
 
+void Searcher::set_feature_cache_size(u32 size_in_mb) {
+    const usize size_in_bytes = 1024 * 1024 * size_in_mb;
+    game_tree_.set_feature_cache_capacity(size_in_bytes / sizeof(FeatureCacheEntry));
+}
+
 void Searcher::set_verbosity(Verbosity verbosity) {
     verbosity_ = verbosity;
 }
@@ -9,6 +9,8 @@
 
 namespace search {
 
+constexpr u32 DEFAULT_FEATURE_CACHE_SIZE = 4;
+
 class Searcher {
   public:
     Searcher();
@@ -16,6 +18,7 @@ class Searcher {
 
     void set_thread_count(u16 thread_count);
     void set_hash_size(u32 size_in_mb);
+    void set_feature_cache_size(u32 size_in_mb);
     void set_verbosity(Verbosity verbosity);
 
     void go(Board &board, const TimeSettings &time_settings = {});
@@ -1,15 +1,18 @@
 #include "tree_half.hpp"
+#include "../chess/move_gen.hpp"
+#include "../util/assert.hpp"
 #include "node.hpp"
 
 namespace search {
 
-TreeHalf::TreeHalf(Index our_half) : our_half_(our_half), filled_size_(0) {}
+TreeHalf::TreeHalf(Index our_half) : our_half_(our_half), capacity_(0), filled_size_(0) {}
 
 void TreeHalf::set_node_capacity(usize capacity) {
     clear();
     nodes_.clear();
     nodes_.shrink_to_fit();
-    nodes_.resize(capacity);
+    nodes_.resize(capacity + MAX_MOVES);
+    capacity_ = capacity;
 }
 
 usize TreeHalf::filled_size() const {
@@ -17,7 +20,7 @@ usize TreeHalf::filled_size() const {
 }
 
 bool TreeHalf::has_room_for(usize n) const {
-    return filled_size() + n <= nodes_.size();
+    return filled_size() + n <= capacity_;
 }
 
 void TreeHalf::clear_dangling_references() {
@@ -32,6 +35,15 @@ void TreeHalf::push_node(const Node &node) {
     nodes_[filled_size_++] = node;
 }
 
+Node *TreeHalf::unfilled_nodes() {
+    return nodes_.data() + filled_size_;
+}
+
+void TreeHalf::fill_nodes(usize n) {
+    vine_assert(has_room_for(n));
+    filled_size_ += n;
+}
+
 NodeIndex TreeHalf::root_idx() const {
     return {0, our_half_};
 }
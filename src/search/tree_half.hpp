@@ -57,6 +57,11 @@ class TreeHalf {
     void clear_dangling_references();
     void push_node(const Node &node);
 
+    // The nodes after the filled ones, which children can be written into before adding them with fill_nodes. There is
+    // always room for MAX_MOVES of them past the capacity, so writers only have to check has_room_for once at the end.
+    [[nodiscard]] Node *unfilled_nodes();
+    void fill_nodes(usize n);
+
     [[nodiscard]] NodeIndex root_idx() const;
     [[nodiscard]] Node &root_node();
     [[nodiscard]] const Node &root_node() const;
@@ -66,6 +71,7 @@ class TreeHalf {
 
   private:
     std::vector<Node> nodes_;
+    usize capacity_;
     usize filled_size_;
     Index our_half_;
 };
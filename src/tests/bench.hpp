@@ -6,6 +6,8 @@
 namespace tests {
 
 void run_bench_tests(std::ostream &out);
+// Measures how many fens a second BoardState can parse and write
+void run_fen_bench(std::ostream &out);
 
 } // namespace tests
 
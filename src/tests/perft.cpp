@@ -1,9 +1,118 @@
 #include "perft.hpp"
 #include "../chess/move_gen.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <optional>
+#include <sstream>
+#include <thread>
 
 namespace tests {
 
+namespace {
+
+// Node counts of subtrees shared between all perft threads. Entries are written without locking, so each one stores
+// its key xored with its data and is only trusted if the two still agree when probed.
+class PerftTable {
+  public:
+    explicit PerftTable(usize hash_mb) : entries_(hash_mb * 1024 * 1024 / sizeof(Entry)) {}
+
+    [[nodiscard]] std::optional<u64> probe(HashKey hash_key, i32 depth) const {
+        if (entries_.empty()) {
+            return std::nullopt;
+        }
+        const auto &entry = entries_[hash_key % entries_.size()];
+        const auto data = entry.data.load(std::memory_order_relaxed);
+        const auto check = entry.check.load(std::memory_order_relaxed);
+        if ((check ^ data) != hash_key || static_cast<i32>(data & DEPTH_MASK) != depth) {
+            return std::nullopt;
+        }
+        return data >> DEPTH_BITS;
+    }
+
+    void store(HashKey hash_key, i32 depth, u64 nodes) {
+        if (entries_.empty()) {
+            return;
+        }
+        auto &entry = entries_[hash_key % entries_.size()];
+        const auto data = nodes << DEPTH_BITS | static_cast<u64>(depth);
+        entry.data.store(data, std::memory_order_relaxed);
+        entry.check.store(hash_key ^ data, std::memory_order_relaxed);
+    }
+
+  private:
+    static constexpr u32 DEPTH_BITS = 8;
+    static constexpr u64 DEPTH_MASK = (1ull << DEPTH_BITS) - 1;
+
+    struct Entry {
+        std::atomic<u64> check;
+        std::atomic<u64> data;
+    };
+
+    std::vector<Entry> entries_;
+};
+
+u64 hashed_perft(Board &board, i32 depth, PerftTable &table) {
+    // Leaves are bulk counted, so caching them would cost more than it saves
+    if (depth <= 1) {
+        return perft(board, depth);
+    }
+    if (const auto nodes = table.probe(board.state().hash_key, depth)) {
+        return *nodes;
+    }
+
+    MoveList moves;
+    generate_moves(board.state(), moves);
+
+    u64 nodes = 0;
+    for (const auto move : moves) {
+        board.make_move(move);
+        nodes += hashed_perft(board, depth - 1, table);
+        board.undo_move();
+    }
+
+    table.store(board.state().hash_key, depth, nodes);
+    return nodes;
+}
+
+// Node counts below each of the given root moves, with threads taking the next uncounted move until none are left
+std::vector<u64> split_perft(const Board &board, const MoveList &moves, i32 depth, const PerftSettings &settings) {
+    std::vector<u64> nodes(moves.size());
+    std::atomic<usize> next_move = 0;
+    PerftTable table(settings.hash_mb);
+
+    const auto worker = [&]() {
+        Board thread_board = board;
+        for (usize i; (i = next_move.fetch_add(1)) < moves.size();) {
+            thread_board.make_move(moves[i]);
+            nodes[i] = hashed_perft(thread_board, depth - 1, table);
+            thread_board.undo_move();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (usize i = 1; i < std::min(settings.threads, moves.size()); ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    return nodes;
+}
+
+std::string format_mnps(u64 nodes, std::chrono::nanoseconds elapsed) {
+    std::ostringstream res;
+    res << std::fixed << std::setprecision(1)
+        << static_cast<f64>(nodes) * 1e3 / static_cast<f64>(std::max<i64>(1, elapsed.count())) << " Mnps";
+    return res.str();
+}
+
+} // namespace
+
 u64 perft(Board &board, i32 depth) {
     MoveList moves;
     generate_moves(board.state(), moves);
@@ -25,18 +134,19 @@ u64 perft(Board &board, i32 depth) {
     return nodes;
 }
 
-u64 perft_print(Board &board, i32 depth, std::ostream &out) {
+u64 perft_print(const Board &board, i32 depth, const PerftSettings &settings, std::ostream &out) {
+    if (depth <= 0) {
+        return 1;
+    }
+
     MoveList moves;
     generate_moves(board.state(), moves);
+    const auto child_nodes = split_perft(board, moves, depth, settings);
 
     u64 nodes = 0;
-    for (const auto move : moves) {
-        board.make_move(move);
-        const auto child_nodes = depth == 1 ? 1 : perft(board, depth - 1);
-        board.undo_move();
-
-        out << move << ": " << child_nodes << std::endl;
-        nodes += child_nodes;
+    for (usize i = 0; i < moves.size(); ++i) {
+        out << moves[i] << ": " << child_nodes[i] << std::endl;
+        nodes += child_nodes[i];
     }
 
     return nodes;
@@ -59,4 +169,37 @@ void run_perft_tests(std::ostream &out) {
     }
 }
 
+void run_perft_bench(const PerftSettings &settings, std::ostream &out) {
+    u64 total_nodes = 0;
+    std::chrono::nanoseconds total_elapsed{};
+    bool all_passed = true;
+
+    for (const auto &batch : PERFT_BATCHES) {
+        const auto [depth, expected] = batch.depths.back();
+        const Board board(batch.fen);
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        MoveList moves;
+        generate_moves(board.state(), moves);
+        u64 nodes = 0;
+        for (const auto child_nodes : split_perft(board, moves, depth, settings)) {
+            nodes += child_nodes;
+        }
+        const auto elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        total_nodes += nodes;
+        total_elapsed += elapsed;
+        all_passed &= nodes == expected;
+
+        out << "FEN: " << batch.fen << "\n";
+        out << "Depth: " << depth << " → Got: " << nodes << ", Expected: " << expected << (nodes == expected ? " ✅" : " ❌")
+            << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms ("
+            << format_mnps(nodes, elapsed) << ")" << std::endl;
+    }
+
+    out << total_nodes << " nodes in " << std::chrono::duration_cast<std::chrono::milliseconds>(total_elapsed).count()
+        << " ms (" << format_mnps(total_nodes, total_elapsed) << ") with " << settings.threads << " threads and "
+        << settings.hash_mb << " MB hash" << (all_passed ? "" : ", some counts were wrong") << std::endl;
+}
+
 } // namespace tests
@@ -17,10 +17,19 @@ const std::array PERFT_BATCHES = {
     PerftBatch{"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
                {{1, 48}, {2, 2039}, {3, 97862}, {4, 4085603}, {5, 193690690}}}};
 
+struct PerftSettings {
+    usize threads = 1;
+    // Size of the table caching subtree node counts, or 0 to count every subtree
+    usize hash_mb = 0;
+};
+
 [[nodiscard]] u64 perft(Board &board, i32 depth);
-[[nodiscard]] u64 perft_print(Board &board, i32 depth, std::ostream &out);
+// Counts the subtree of each root move, spread over settings.threads threads, and prints them in move generation order
+[[nodiscard]] u64 perft_print(const Board &board, i32 depth, const PerftSettings &settings, std::ostream &out);
 
 void run_perft_tests(std::ostream &out);
+// Times the deepest listed depth of every PERFT_BATCHES position and checks it against the expected count
+void run_perft_bench(const PerftSettings &settings, std::ostream &out);
 
 } // namespace tests
 
@@ -1,10 +1,13 @@
 #include "uci.hpp"
+#include "../chess/magics.hpp"
 #include "../chess/move_gen.hpp"
 #include "../data_gen/game_runner.hpp"
+#include "../eval/networks.hpp"
 #include "../eval/policy_network.hpp"
 #include "../eval/value_network.hpp"
 #include "../tests/bench.hpp"
 #include "../tests/perft.hpp"
+#include "../util/cpu.hpp"
 #include "../util/math.hpp"
 #include "../util/string.hpp"
 #include "../util/tunable.hpp"
@@ -12,14 +15,17 @@
 #include "../util/types.hpp"
 #include "options.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 namespace uci {
@@ -33,22 +39,123 @@ Handler::Handler() {
         std::make_unique<IntegerOption>("Hash", 16, 1, std::numeric_limits<i32>::max(), [&](const Option &option) {
             searcher_.set_hash_size(std::get<i32>(option.value_as_variant()));
         }));
+    options.add(std::make_unique<IntegerOption>(
+        "FeatureCache", search::DEFAULT_FEATURE_CACHE_SIZE, 0, std::numeric_limits<i32>::max(),
+        [&](const Option &option) { searcher_.set_feature_cache_size(std::get<i32>(option.value_as_variant())); }));
     options.add(std::make_unique<BoolOption>("Minimal", false, [&](const Option &option) {
         searcher_.set_verbosity(std::get<bool>(option.value_as_variant()) ? search::Verbosity::MINIMAL
                                                                           : search::Verbosity::VERBOSE);
     }));
     options.add(std::make_unique<BoolOption>("UCI_Chess960", false));
 
+    const auto add_network_option = [&](std::string_view name, auto load) {
+        options.add(
+            std::make_unique<StringOption>(name, std::string(network::EMBEDDED), [&, load](const Option &option) {
+                const auto path = std::get<std::string>(option.value_as_variant());
+                if (const auto error = load(path)) {
+                    std::cout << "info string error: " << *error << std::endl;
+                    return;
+                }
+                // Cached evaluations came from the previous network
+                searcher_.clear();
+            }));
+    };
+    add_network_option("EvalFile", network::load_combined_networks);
+    add_network_option("ValueFile", network::load_value_network);
+    add_network_option("PolicyFile", network::load_policy_network);
+    options.add(std::make_unique<BoolOption>("PackedPolicy", false, [&](const Option &option) {
+        network::policy::set_packed_output(std::get<bool>(option.value_as_variant()));
+        searcher_.clear();
+    }));
+
     board_ = Board(STARTPOS_FEN);
+    position_fen_ = STARTPOS_FEN;
 }
 
-void Handler::handle_perft(std::ostream &out, int depth) {
+void Handler::handle_perft(std::ostream &out, const std::vector<std::string_view> &parts) {
+    vine_assert(parts[0] == "perft");
+    if (parts.size() < 2) {
+        out << "info string error: perft needs a depth or 'bench'" << std::endl;
+        return;
+    }
+
+    // A single perft stays on one thread unless asked otherwise, while the bench uses every core by default
+    const bool bench = parts[1] == "bench";
+    tests::PerftSettings settings;
+    if (bench) {
+        settings.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    constexpr std::string_view threads_str = "threads=";
+    constexpr std::string_view hash_str = "hash=";
+    for (const auto part : parts) {
+        std::optional<usize> value;
+        if (part.starts_with(threads_str)) {
+            value = util::parse_number<usize>(part.substr(threads_str.length()));
+            settings.threads = std::max<usize>(1, value.value_or(0));
+        } else if (part.starts_with(hash_str)) {
+            value = util::parse_number<usize>(part.substr(hash_str.length()));
+            settings.hash_mb = value.value_or(0);
+        } else {
+            continue;
+        }
+        if (!value) {
+            out << "info string error: invalid perft argument: " << part << std::endl;
+            return;
+        }
+    }
+
+    if (bench) {
+        tests::run_perft_bench(settings, out);
+        return;
+    }
+
+    const auto depth = util::parse_number<i32>(parts[1]);
+    if (!depth) {
+        out << "info string error: invalid perft depth: " << parts[1] << std::endl;
+        return;
+    }
     const auto start = std::chrono::high_resolution_clock::now();
-    const auto nodes = tests::perft_print(board_, depth, out);
+    const auto nodes = tests::perft_print(board_, *depth, settings, out);
     const auto end = std::chrono::high_resolution_clock::now();
     const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
-    const auto nps = static_cast<u64>(static_cast<double>(nodes) * 1e9 / elapsed.count());
-    out << "Nodes searched: " << nodes << " (" << nps << "nps)\n";
+    const auto nps = static_cast<u64>(static_cast<double>(nodes) * 1e9 / std::max<i64>(1, elapsed.count()));
+    out << "Nodes searched: " << nodes << " (" << nps / 1'000'000 << "." << nps / 100'000 % 10 << " Mnps)\n";
+}
+
+void Handler::handle_position(const std::vector<std::string_view> &parts) {
+    const auto moves_it = std::ranges::find(parts, "moves");
+    std::string_view fen;
+    if (parts[1] == "startpos") {
+        fen = STARTPOS_FEN;
+    } else if (parts[1] == "fen" && moves_it - parts.begin() > 2) {
+        // The parts all point into the same line, so the fen is everything from its first to its last part
+        fen = std::string_view(parts[2].data(), (moves_it - 1)->data() + (moves_it - 1)->size());
+    } else {
+        return;
+    }
+    const std::span<const std::string_view> moves(moves_it == parts.end() ? moves_it : moves_it + 1, parts.end());
+
+    // GUIs send the whole game again before every move, so only replay the moves that differ from the last position
+    usize shared_moves = 0;
+    if (fen == position_fen_) {
+        while (shared_moves < std::min(moves.size(), position_moves_.size()) &&
+               moves[shared_moves] == position_moves_[shared_moves]) {
+            ++shared_moves;
+        }
+        board_.undo_n_moves(position_moves_.size() - shared_moves);
+        position_moves_.resize(shared_moves);
+    } else {
+        board_ = Board(fen);
+        position_fen_ = fen;
+        position_moves_.clear();
+    }
+
+    const auto chess960 = std::get<bool>(options.get("UCI_Chess960")->value_as_variant());
+    for (const auto move : moves.subspan(shared_moves)) {
+        board_.make_move(board_.create_move(move, chess960));
+        position_moves_.emplace_back(move);
+    }
 }
 
 void Handler::handle_setoption(std::ostream &out, const std::vector<std::string_view> &parts) {
@@ -125,10 +232,12 @@ void Handler::handle_genfens(std::ostream &out, const std::vector<std::string_vi
     }
     rng::seed_generator(seed);
 
+    const auto chess960 = std::get<bool>(options.get("UCI_Chess960")->value_as_variant());
+    std::array<char, MAX_FEN_LENGTH> fen;
     for (usize i = 0; i < count; ++i) {
         const auto opening = opening_fens[rng::next_u64(0, opening_fens.size() - 1)];
-        out << "info string genfens " << datagen::generate_opening(opening, random_moves, temperature, gamma).to_fen()
-            << std::endl;
+        const auto state = datagen::generate_opening(opening, random_moves, temperature, gamma);
+        out << "info string genfens " << std::string_view(fen.data(), state.write_fen(fen, chess960)) << std::endl;
     }
 }
 
@@ -207,17 +316,21 @@ void Handler::process_input(std::istream &in, std::ostream &out) {
             out << "id name Vine" << std::endl;
             out << "id author Aron Petkovski, Jonathan Hallström" << std::endl;
             out << options;
+            out << "info string using " << util::cpu::isa_name(util::cpu::selected_isa()) << " kernels"
+                << (PEXT_ATTACKS ? " and pext slider attacks" : "")
+                << (VECTOR_SLIDER_ATTACKS ? " and avx512 slider fills" : "") << std::endl;
             out << "uciok" << std::endl;
         } else if (parts[0] == "isready") {
             out << "readyok" << std::endl;
         } else if (parts[0] == "ucinewgame") {
             handle_newgame();
         } else if (parts[0] == "perft") {
-            handle_perft(out, *util::parse_number(parts[1]));
+            handle_perft(out, parts);
         } else if (parts[0] == "print") {
             out << "static eval:\n";
 
-            const auto eval = network::value::evaluate(board_.state());
+            const auto features = network::extract_features(board_.state());
+            const auto eval = network::value::evaluate(features);
             util::tui::set_color(out, util::tui::get_score_color(util::math::sigmoid(eval)));
             out << std::round(network::value::EVAL_SCALE * eval) << '\n';
             util::tui::reset_color(out);
@@ -226,7 +339,7 @@ void Handler::process_input(std::istream &in, std::ostream &out) {
             MoveList moves;
             generate_moves(board_.state(), moves);
 
-            const network::policy::PolicyContext ctx(board_.state());
+            const network::policy::PolicyContext ctx(features);
 
             std::vector<f64> logits;
             logits.reserve(moves.size());
@@ -272,7 +385,8 @@ void Handler::process_input(std::istream &in, std::ostream &out) {
             }
             out << '\n';
 
-            out << "fen:\n" << board_.state().to_fen() << '\n';
+            out << "fen:\n"
+                << board_.state().to_fen(std::get<bool>(options.get("UCI_Chess960")->value_as_variant())) << '\n';
             out << '\n';
 
             out << "board:\n";
@@ -282,33 +396,13 @@ void Handler::process_input(std::istream &in, std::ostream &out) {
         } else if (parts[0] == "go") {
             handle_go(out, parts);
         } else if (parts[0] == "position") {
-            if (parts[1] == "fen" || parts[1] == "startpos") {
-                std::string fen;
-                size_t moves_pos = line.find(" moves ");
-
-                if (parts[1] == "fen") {
-                    const size_t fen_start = line.find("fen ") + 4;
-                    if (moves_pos != std::string::npos) {
-                        fen = line.substr(fen_start, moves_pos - fen_start);
-                    } else {
-                        fen = line.substr(fen_start);
-                    }
-                } else { // startpos
-                    fen = std::string(STARTPOS_FEN);
-                }
-
-                board_ = Board(fen);
-
-                if (moves_pos != std::string::npos) {
-                    std::istringstream moves_stream(line.substr(moves_pos + 7));
-                    std::string move_str;
-                    while (moves_stream >> move_str) {
-                        board_.make_move(board_.create_move(move_str));
-                    }
-                }
-            }
+            handle_position(parts);
         } else if (parts[0] == "bench") {
-            tests::run_bench_tests(out);
+            if (parts.size() > 1 && parts[1] == "fen") {
+                tests::run_fen_bench(out);
+            } else {
+                tests::run_bench_tests(out);
+            }
         } else if (parts[0] == "quit") {
             std::exit(0);
         } else if (parts[0] == "genfens") {
@@ -18,7 +18,8 @@ class Handler {
     void initialize_tunables();
 
   private:
-    void handle_perft(std::ostream &out, int depth);
+    void handle_perft(std::ostream &out, const std::vector<std::string_view> &parts);
+    void handle_position(const std::vector<std::string_view> &parts);
     void handle_setoption(std::ostream &out, const std::vector<std::string_view> &parts);
     void handle_go(std::ostream &out, const std::vector<std::string_view> &parts);
     void handle_genfens(std::ostream &out, const std::vector<std::string_view> &parts);
@@ -26,6 +27,9 @@ class Handler {
     void handle_newgame();
 
     Board board_;
+    // The position board_ was last set to, kept to tell which moves a new position command adds
+    std::string position_fen_;
+    std::vector<std::string> position_moves_;
     search::Searcher searcher_;
 };
 
@@ -0,0 +1,74 @@
+#include "cpu.hpp"
+
+#include <array>
+
+namespace util::cpu {
+
+std::string_view isa_name(Isa isa) {
+    switch (isa) {
+    case Isa::NEON:
+        return "neon";
+    case Isa::SSE2:
+        return "sse2";
+    case Isa::SSSE3:
+        return "ssse3";
+    case Isa::AVX2:
+        return "avx2";
+    case Isa::AVX512:
+        return "avx512";
+    case Isa::AVX512VNNI:
+        return "avx512vnni";
+    default:
+        return "generic";
+    }
+}
+
+bool supports(Isa isa) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    // These mirror the flags each build target in the Makefile compiles with
+    const bool sse2 = __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("sse2");
+    const bool ssse3 = sse2 && __builtin_cpu_supports("ssse3");
+    const bool avx2 = ssse3 && __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("bmi") &&
+                      __builtin_cpu_supports("fma") && __builtin_cpu_supports("avx2");
+    const bool avx512 = avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    const bool avx512vnni = avx512 && __builtin_cpu_supports("avx512vnni");
+    switch (isa) {
+    case Isa::GENERIC:
+        return true;
+    case Isa::SSE2:
+        return sse2;
+    case Isa::SSSE3:
+        return ssse3;
+    case Isa::AVX2:
+        return avx2;
+    case Isa::AVX512:
+        return avx512;
+    case Isa::AVX512VNNI:
+        return avx512vnni;
+    default:
+        return false;
+    }
+#else
+    return isa == Isa::GENERIC || isa == COMPILED_ISA;
+#endif
+}
+
+Isa selected_isa() {
+#ifdef DISPATCH
+    static const Isa selected = [] {
+        constexpr std::array DISPATCH_ISAS = {Isa::AVX512VNNI, Isa::AVX512, Isa::AVX2};
+        for (const auto isa : DISPATCH_ISAS) {
+            if (supports(isa)) {
+                return isa;
+            }
+        }
+        return Isa::SSE2;
+    }();
+    return selected;
+#else
+    return COMPILED_ISA;
+#endif
+}
+
+} // namespace util::cpu
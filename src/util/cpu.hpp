@@ -0,0 +1,85 @@
+#ifndef CPU_HPP
+#define CPU_HPP
+
+#include "types.hpp"
+
+#include <string_view>
+
+// Name of the instruction set the current translation unit is compiled for. Code whose machine code depends on it,
+// such as the simd helpers and network kernels, lives in a namespace of this name so that copies compiled for different
+// instruction sets in dispatch builds are never merged by the linker.
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+#define CPU_ISA avx512vnni
+#elif defined(__AVX512F__) && defined(__AVX512BW__)
+#define CPU_ISA avx512
+#elif defined(__AVX2__)
+#define CPU_ISA avx2
+#elif defined(__SSSE3__)
+#define CPU_ISA ssse3
+#elif defined(__SSE2__)
+#define CPU_ISA sse2
+#elif defined(__ARM_NEON)
+#define CPU_ISA neon
+#else
+#define CPU_ISA generic
+#endif
+
+namespace util::cpu {
+
+enum class Isa : u8 {
+    GENERIC,
+    NEON,
+    SSE2,
+    SSSE3,
+    AVX2,
+    AVX512,
+    AVX512VNNI,
+};
+
+// Instruction set the current translation unit is compiled for, matching CPU_ISA
+constexpr Isa COMPILED_ISA =
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+    Isa::AVX512VNNI;
+#elif defined(__AVX512F__) && defined(__AVX512BW__)
+    Isa::AVX512;
+#elif defined(__AVX2__)
+    Isa::AVX2;
+#elif defined(__SSSE3__)
+    Isa::SSSE3;
+#elif defined(__SSE2__)
+    Isa::SSE2;
+#elif defined(__ARM_NEON)
+    Isa::NEON;
+#else
+    Isa::GENERIC;
+#endif
+
+[[nodiscard]] std::string_view isa_name(Isa isa);
+
+// Whether the running cpu (and operating system) supports everything the build flags of the given instruction set use
+[[nodiscard]] bool supports(Isa isa);
+
+// Instruction set of the kernels used by this binary. In dispatch builds this is the best one the cpu supports out of
+// the ones kernels are built for, otherwise it is fixed at compile time.
+[[nodiscard]] Isa selected_isa();
+
+#ifdef DISPATCH
+// Picks between the copies of something built once per dispatch instruction set
+template <typename T>
+[[nodiscard]] const T &select(const T &sse2, const T &avx2, const T &avx512, const T &avx512vnni) {
+    switch (selected_isa()) {
+    case Isa::AVX512VNNI:
+        return avx512vnni;
+    case Isa::AVX512:
+        return avx512;
+    case Isa::AVX2:
+        return avx2;
+    default:
+        return sse2;
+    }
+}
+#endif
+
+} // namespace util::cpu
+
+#endif // CPU_HPP
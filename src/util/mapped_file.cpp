@@ -0,0 +1,118 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace util {
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        unmap();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+        mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+std::optional<MappedFile> MappedFile::open(const std::string &path) {
+    MappedFile res;
+#ifdef _WIN32
+    const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return std::nullopt;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return std::nullopt;
+    }
+    // The mapping keeps its own reference to the file, so the file handle isn't needed afterwards
+    res.mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (res.mapping_ == nullptr) {
+        return std::nullopt;
+    }
+    res.data_ = MapViewOfFile(res.mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (res.data_ == nullptr) {
+        return std::nullopt;
+    }
+    res.size_ = static_cast<usize>(size.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return std::nullopt;
+    }
+    void *data = mmap(nullptr, static_cast<usize>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        return std::nullopt;
+    }
+    res.data_ = data;
+    res.size_ = static_cast<usize>(st.st_size);
+
+    // Both are only hints: start reading the weights in ahead of the first evaluation, and back them with huge pages
+    // where the kernel supports it for file mappings
+    madvise(res.data_, res.size_, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+    madvise(res.data_, res.size_, MADV_HUGEPAGE);
+#endif
+#endif
+    return res;
+}
+
+const u8 *MappedFile::data() const {
+    return static_cast<const u8 *>(data_);
+}
+
+usize MappedFile::size() const {
+    return size_;
+}
+
+void MappedFile::unmap() {
+#ifdef _WIN32
+    if (data_ != nullptr) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+        CloseHandle(mapping_);
+    }
+    mapping_ = nullptr;
+#else
+    if (data_ != nullptr) {
+        munmap(data_, size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+} // namespace util
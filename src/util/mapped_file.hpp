@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include "types.hpp"
+
+#include <optional>
+#include <string>
+
+namespace util {
+
+// A read-only memory mapping of a whole file. Mappings start on a page boundary, so the data is at least 64 byte
+// aligned.
+class MappedFile {
+  public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile();
+
+    // Returns std::nullopt if the file can't be opened or mapped
+    [[nodiscard]] static std::optional<MappedFile> open(const std::string &path);
+
+    [[nodiscard]] const u8 *data() const;
+    [[nodiscard]] usize size() const;
+
+  private:
+    void unmap();
+
+    void *data_ = nullptr;
+    usize size_ = 0;
+#ifdef _WIN32
+    void *mapping_ = nullptr;
+#endif
+};
+
+} // namespace util
+
+#endif // MAPPED_FILE_HPP
@@ -1,14 +1,24 @@
 #ifndef SIMD_HPP
 #define SIMD_HPP
 
+#include "cpu.hpp"
 #include "types.hpp"
 #include <cmath>
 #include <cstring>
+#include <type_traits>
+
+#if __x86_64__
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 namespace util {
 
+// Everything here compiles differently for each instruction set, see CPU_ISA
+inline namespace CPU_ISA {
+
 #if __x86_64__
-#include <immintrin.h>
 #if defined(__AVX512F__)
 constexpr auto NATIVE_VECTOR_BYTES = 64;
 #elif defined(__AVX2__)
@@ -20,7 +30,6 @@ constexpr auto NATIVE_VECTOR_BYTES = 0;
 #endif
 #elif defined(__arm__) || defined(__aarch64__)
 #if defined(__ARM_NEON)
-#include <arm_neon.h>
 constexpr auto NATIVE_VECTOR_BYTES = 16;
 #else
 constexpr auto NATIVE_VECTOR_BYTES = 0;
@@ -63,10 +72,12 @@ inline SimdVector<T, N> min(SimdVector<T, N> a, SimdVector<T, N> b) {
 
 template <class T = i16, usize N = NATIVE_SIZE<T>>
 inline SimdVector<T, N> set1(T val) {
-    std::array<T, N> vals;
-    vals.fill(val);
+    T vals[N];
+    for (auto &v : vals) {
+        v = val;
+    }
     SimdVector<T, N> res;
-    std::memcpy(&res, vals.data(), sizeof(res));
+    std::memcpy(&res, vals, sizeof(res));
     return res;
 }
 
@@ -87,6 +98,12 @@ inline void storeu(T *ptr, SimdVector<T, N> v) {
     std::memcpy(ptr, &v, sizeof(v));
 }
 
+// Same as std::bit_cast, which would be instantiated outside of this namespace for the vector types
+template <class To, class From>
+inline To bit_cast(const From &from) {
+    return __builtin_bit_cast(To, from);
+}
+
 template <class To, class From, usize N>
 inline SimdVector<To, N> convert_vector(SimdVector<From, N> v) {
     return __builtin_convertvector(v, SimdVector<To, N>);
@@ -117,11 +134,40 @@ inline T reduce_vector(SimdVector<T, N> v) {
     return res;
 }
 
+// Computes a * b + c with a single rounding, using the fused multiply-add instructions for native width f32 vectors
 template <class T, usize N>
 inline SimdVector<T, N> fma(SimdVector<T, N> a, SimdVector<T, N> b, SimdVector<T, N> c) {
-    for (usize i = 0; i < N; ++i)
-        a[i] = std::fma(a[i], b[i], c[i]);
-    return a;
+#if defined(__AVX512F__)
+    if constexpr (std::is_same_v<T, f32> && N == 16) {
+        return _mm512_fmadd_ps(a, b, c);
+    }
+#endif
+#if defined(__FMA__)
+    if constexpr (std::is_same_v<T, f32> && N == 8) {
+        return _mm256_fmadd_ps(a, b, c);
+    }
+    if constexpr (std::is_same_v<T, f32> && N == 4) {
+        return _mm_fmadd_ps(a, b, c);
+    }
+#endif
+#if defined(__ARM_FEATURE_FMA)
+    if constexpr (std::is_same_v<T, f32> && N == 4) {
+        return vfmaq_f32(c, a, b);
+    }
+#endif
+    // Split wider vectors into halves until they reach a native width
+    if constexpr (N * sizeof(T) > NATIVE_VECTOR_BYTES && N > 1) {
+        const auto lo = fma<T, N / 2>(lower_half<T, N>(a), lower_half<T, N>(b), lower_half<T, N>(c));
+        const auto hi = fma<T, N / 2>(upper_half<T, N>(a), upper_half<T, N>(b), upper_half<T, N>(c));
+        SimdVector<T, N> res;
+        std::memcpy(&res, &lo, sizeof(lo));
+        std::memcpy(reinterpret_cast<T *>(&res) + N / 2, &hi, sizeof(hi));
+        return res;
+    } else {
+        for (usize i = 0; i < N; ++i)
+            a[i] = std::fma(a[i], b[i], c[i]);
+        return a;
+    }
 }
 
 #ifdef __x86_64__
@@ -130,16 +176,40 @@ inline SimdVector<i32, 16> madd_epi16(SimdVector<i16, 32> a, SimdVector<i16, 32>
     return _mm512_madd_epi16(a, b);
 }
 #endif
+#if defined(__AVX512VNNI__)
+// Adds the dot product of each group of 4 unsigned bytes of a with the 4 signed bytes of b to each i32 lane of sum
+inline SimdVector<i32, 16> dpbusd_epi32(SimdVector<i32, 16> sum, SimdVector<u8, 64> a, SimdVector<i8, 64> b) {
+    return _mm512_dpbusd_epi32(sum, a, b);
+}
+#endif
+#if defined(__AVX512BW__) && !defined(__AVX512VNNI__)
+// Without VNNI, dpbusd is emulated with maddubs, whose sums of 2 products saturate at the i16 limits, so callers must keep
+// those in range, for example by limiting a to 128. The narrower emulations below are the same.
+inline SimdVector<i32, 16> dpbusd_epi32(SimdVector<i32, 16> sum, SimdVector<u8, 64> a, SimdVector<i8, 64> b) {
+    const SimdVector<i32, 16> products = _mm512_madd_epi16(_mm512_maddubs_epi16(a, b), _mm512_set1_epi16(1));
+    return sum + products;
+}
+#endif
 #if defined(__AVX2__)
 inline SimdVector<i32, 8> madd_epi16(SimdVector<i16, 16> a, SimdVector<i16, 16> b) {
     return _mm256_madd_epi16(a, b);
 }
+inline SimdVector<i32, 8> dpbusd_epi32(SimdVector<i32, 8> sum, SimdVector<u8, 32> a, SimdVector<i8, 32> b) {
+    const SimdVector<i32, 8> products = _mm256_madd_epi16(_mm256_maddubs_epi16(a, b), _mm256_set1_epi16(1));
+    return sum + products;
+}
 #endif
 #if defined(__SSE__)
 inline SimdVector<i32, 4> madd_epi16(SimdVector<i16, 8> a, SimdVector<i16, 8> b) {
     return _mm_madd_epi16(a, b);
 }
 #endif
+#if defined(__SSSE3__)
+inline SimdVector<i32, 4> dpbusd_epi32(SimdVector<i32, 4> sum, SimdVector<u8, 16> a, SimdVector<i8, 16> b) {
+    const SimdVector<i32, 4> products = _mm_madd_epi16(_mm_maddubs_epi16(a, b), _mm_set1_epi16(1));
+    return sum + products;
+}
+#endif
 
 #endif
 
@@ -156,6 +226,8 @@ inline SimdVector<i32, 4> madd_epi16(SimdVector<i16, 8> a, SimdVector<i16, 8> b)
 
 #endif
 
+} // namespace CPU_ISA
+
 } // namespace util
 
 #endif // SIMD_HPP
@@ -1,9 +1,91 @@
+import struct
 import sys
+import zlib
+from array import array
+
+# Must match NetworkHeader in src/eval/networks.cpp
+MAGIC = 0x454E4956
+VERSION = 1
+HEADER_FORMAT = "<IHH4I2iQIH18x"
+# Header flag for value networks whose feature transformer weights are stored as i8
+NARROW_FT_WEIGHTS = 1
+NUM_FEATURES = 2 * 2 * 2 * 6 * 64
+POLICY_OUTPUTS = 3920
+
+
+def padded(size):
+    return (size + 63) // 64 * 64
+
+
+def value_size(l1, l2, l3):
+    return padded(NUM_FEATURES * l1 * 2 + l1 * 2 + l1 // 2 * l2 + l2 * 4 + l2 * l3 * 4 + l3 * 4 + l3 * 4 + 4)
+
+
+def policy_size(l1):
+    return padded(NUM_FEATURES * l1 + l1 + POLICY_OUTPUTS * l1 // 2 + POLICY_OUTPUTS)
+
+
+# kind, quantisation constants and layer sizes of every architecture the engine is built for, which must match the
+# Architectures lists in src/eval/value_network.hpp and src/eval/policy_network.hpp. The first is the default.
+NETWORKS = {
+    "value": (0, (255, 64), [(NUM_FEATURES, 4096, 16, 128), (NUM_FEATURES, 1024, 16, 32)]),
+    "policy": (1, (128, 0), [(NUM_FEATURES, 4096, POLICY_OUTPUTS, 0), (NUM_FEATURES, 1024, POLICY_OUTPUTS, 0)]),
+}
+
+
+def network_size(kind, layer_sizes):
+    if kind == "value":
+        return value_size(*layer_sizes[1:])
+    return policy_size(layer_sizes[1])
+
+
+def narrow_value_ft(data, l1, path):
+    # Stores the feature transformer weights as i8 when every one of them fits, which halves the memory refreshes read.
+    # The weights are a multiple of 64 bytes either way, so the rest of the network keeps its alignment and padding.
+    ft_size = NUM_FEATURES * l1 * 2
+    ft = memoryview(data)[:ft_size].cast('h')
+    if min(ft) < -128 or max(ft) > 127:
+        print(f"warning: {path} has feature transformer weights outside the i8 range, the slower i16 path will be used")
+        return data, 0
+    return array('b', ft).tobytes() + data[ft_size:], NARROW_FT_WEIGHTS
+
+
+def with_header(kind, data, path):
+    if len(data) >= 4 and struct.unpack_from("<I", data)[0] == MAGIC:
+        return data
+
+    kind_id, quantisation, architectures = NETWORKS[kind]
+    # The architecture is recognised by its size. Trainers may leave out the padding at the end of the network.
+    for layer_sizes in architectures:
+        size = network_size(kind, layer_sizes)
+        if size - 64 < len(data) <= size:
+            break
+    else:
+        sizes = ", ".join(str(network_size(kind, layer_sizes)) for layer_sizes in architectures)
+        print(f"error: {path} is {len(data)} bytes, expected a {kind} network of one of {sizes} bytes")
+        sys.exit(1)
+    data += b'\x00' * (size - len(data))
+    flags = 0
+    if kind == "value":
+        data, flags = narrow_value_ft(data, layer_sizes[1], path)
+
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, kind_id, *layer_sizes, *quantisation, len(data),
+                         zlib.crc32(data), flags)
+    return header + data
 
 
 def main():
+    if len(sys.argv) == 4 and sys.argv[1] in NETWORKS:
+        kind, net_path, output_path = sys.argv[1:]
+        with open(net_path, 'rb') as f:
+            data = f.read()
+        with open(output_path, 'wb') as output:
+            output.write(with_header(kind, data, net_path))
+        return
+
     if len(sys.argv) != 4:
         print("usage: python3 concat_networks.py <value net> <policy net> <output>")
+        print("       python3 concat_networks.py <value|policy> <net> <output>")
         sys.exit(1)
 
     value_net_path = sys.argv[1]
@@ -16,18 +98,13 @@ def main():
         print("warning: policy net has value net extension")
 
     with open(value_net_path, 'rb') as f:
-        value_net_data = f.read()
+        value_net_data = with_header("value", f.read(), value_net_path)
 
     with open(policy_net_path, 'rb') as f:
-        policy_net_data = f.read()
-
-    value_net_size = len(value_net_data)
-    padding_size = (64 - (value_net_size % 64)) % 64
-    padding = b'\x00' * padding_size
+        policy_net_data = with_header("policy", f.read(), policy_net_path)
 
     with open(output_path, 'wb') as combined:
         combined.write(value_net_data)
-        combined.write(padding)
         combined.write(policy_net_data)
 
 
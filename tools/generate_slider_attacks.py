@@ -0,0 +1,72 @@
+import re
+import struct
+from pathlib import Path
+
+# Writes the slider attack tables that src/chess/magics.cpp embeds, one indexed by the magics and one by pext. Both are
+# generated from the magics in src/chess/magics.hpp, so they have to be regenerated whenever those change.
+ROOT = Path(__file__).resolve().parent.parent
+MAGICS_HEADER = ROOT / "src" / "chess" / "magics.hpp"
+OUTPUTS = {
+    "magic": ROOT / "src" / "chess" / "slider_attacks_magic.bin",
+    "pext": ROOT / "src" / "chess" / "slider_attacks_pext.bin",
+}
+
+ROOK_DIRECTIONS = [(1, 0), (-1, 0), (0, 1), (0, -1)]
+BISHOP_DIRECTIONS = [(1, 1), (1, -1), (-1, 1), (-1, -1)]
+U64_MASK = (1 << 64) - 1
+
+
+def read_magics(name):
+    source = MAGICS_HEADER.read_text()
+    table = re.search(name + r" = \{(.*?)\};", source, re.S).group(1)
+    entries = re.findall(r"MagicEntry\{0x([0-9a-f]+)ull, 0x([0-9a-f]+)ull, (\d+)\}", table)
+    assert len(entries) == 64, f"expected 64 entries in {name}, found {len(entries)}"
+    return [(int(mask, 16), int(magic, 16), int(shift)) for mask, magic, shift in entries]
+
+
+def attacks(sq, occ, directions):
+    res = 0
+    for rank_diff, file_diff in directions:
+        rank, file = sq // 8 + rank_diff, sq % 8 + file_diff
+        while 0 <= rank < 8 and 0 <= file < 8:
+            bit = 1 << (rank * 8 + file)
+            res |= bit
+            if occ & bit:
+                break
+            rank, file = rank + rank_diff, file + file_diff
+    return res
+
+
+def fill(table, magics, directions, pext):
+    for sq, (mask, magic, shift) in enumerate(magics):
+        entries = [0] * (1 << (64 - shift))
+        # The carry-rippler trick steps through every subset of the mask in increasing order of its bits, which is
+        # exactly the order of the pext indices
+        subset, pext_index = 0, 0
+        while True:
+            index = pext_index if pext else ((subset * magic) & U64_MASK) >> shift
+            moves = attacks(sq, subset, directions)
+            # A magic may map several occupancies to one entry, but only if they have the same attacks
+            assert entries[index] in (0, moves), f"magic of square {sq} maps different attacks to entry {index}"
+            entries[index] = moves
+            subset = (subset - mask) & mask
+            pext_index += 1
+            if subset == 0:
+                break
+        table.extend(entries)
+
+
+def main():
+    rook_magics = read_magics("ROOK_MAGICS")
+    bishop_magics = read_magics("BISHOP_MAGICS")
+    for kind, path in OUTPUTS.items():
+        # Rooks come first, followed by bishops, the same as ROOK_OFFSETS and BISHOP_OFFSETS
+        table = []
+        fill(table, rook_magics, ROOK_DIRECTIONS, kind == "pext")
+        fill(table, bishop_magics, BISHOP_DIRECTIONS, kind == "pext")
+        path.write_bytes(struct.pack(f"<{len(table)}Q", *table))
+        print(f"wrote {len(table)} entries to {path.relative_to(ROOT)}")
+
+
+if __name__ == "__main__":
+    main()